@@ -0,0 +1,328 @@
+#ifndef BASE_H
+#define BASE_H
+
+//=========================================================================
+// Base64 codec shared by DearOMG-community, DearOMG-vendor and
+// DearOMG-parser, used for the json/yaml payloads and the offset footer.
+//
+// Whole blocks go through SSSE3 (12 bytes <-> 16 chars) or AVX2
+// (24 bytes <-> 32 chars) when the build enables them; the rest, padding
+// included, takes the scalar path. The tables are constant, so threads
+// can decode concurrently.
+//=========================================================================
+
+#include <math.h>
+#include <vector>
+#include <stdlib.h>
+#include <stdint.h>
+
+#if defined __AVX2__
+#include <immintrin.h>
+#define BASE64_USE_AVX2
+#define BASE64_USE_SSSE3
+#elif defined __SSSE3__
+#include <tmmintrin.h>
+#define BASE64_USE_SSSE3
+#endif
+
+namespace Base64
+{
+	typedef unsigned char byte;
+
+	static const char charTable[64] =
+	{
+		'A','B','C','D','E','F','G','H','I','J',
+		'K','L','M','N','O','P','Q','R','S','T',
+		'U','V','W','X','Y','Z','a','b','c','d',
+		'e','f','g','h','i','j','k','l','m','n',
+		'o','p','q','r','s','t','u','v','w','x',
+		'y','z','0','1','2','3','4','5','6','7',
+		'8','9', '+','/'
+	};
+
+	// 6-bit value of each character, 0 for characters outside the alphabet
+	static const byte byteTable[256] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 62, 0, 0, 0, 63,
+		52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 0, 0, 0, 0, 0, 0,
+		0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+		15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 0, 0, 0, 0, 0,
+		0, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+		41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+	};
+
+	size_t binaryToTextSize(size_t byteCount);
+	size_t binaryToText(const void* from, size_t byteCount, char* to);
+	size_t textToBinarySize(size_t charCount);
+	size_t textToBinary(const char* from, size_t charCount, void* to);
+
+#if defined BASE64_USE_SSSE3
+	// 16 6-bit indices, one per byte, to their characters
+	static inline __m128i EncodeLookup(__m128i indices)
+	{
+		const __m128i shiftLUT = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+		__m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		__m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+		return _mm_add_epi8(_mm_shuffle_epi8(shiftLUT, result), indices);
+	}
+
+	// 12 bytes from the first 12 of 16 loaded to 16 characters
+	static inline __m128i EncodeBlock(__m128i in)
+	{
+		in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+		__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		__m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+
+		return EncodeLookup(_mm_or_si128(t0, t1));
+	}
+
+	// 16 characters to 12 bytes in the low lanes; false if any is outside the alphabet
+	static inline bool DecodeBlock(__m128i in, __m128i& out)
+	{
+		const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m128i nibble = _mm_set1_epi8(0x0f);
+
+		__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+		__m128i loNibbles = _mm_and_si128(in, nibble);
+
+		__m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+		__m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF) return false;
+
+		__m128i eq2F = _mm_cmpeq_epi8(in, _mm_set1_epi8(0x2f));
+		__m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+		in = _mm_add_epi8(in, roll);
+
+		// 4 x 6 bits -> 24 bits per dword, then drop the top byte of each
+		__m128i merged = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+		merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+
+		out = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		return true;
+	}
+#endif
+
+#if defined BASE64_USE_AVX2
+	static inline __m256i EncodeLookup(__m256i indices)
+	{
+		const __m256i shiftLUT = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+		__m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		__m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+
+		return _mm256_add_epi8(_mm256_shuffle_epi8(shiftLUT, result), indices);
+	}
+
+	// 24 bytes, 12 per lane, to 32 characters
+	static inline __m256i EncodeBlock(__m256i in)
+	{
+		in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+			10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+		__m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+		__m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+
+		return EncodeLookup(_mm256_or_si256(t0, t1));
+	}
+
+	// 32 characters to 24 bytes in the low lanes; false if any is outside the alphabet
+	static inline bool DecodeBlock(__m256i in, __m256i& out)
+	{
+		const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+		__m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), nibble);
+		__m256i loNibbles = _mm256_and_si256(in, nibble);
+
+		__m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+		__m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+
+		if (!_mm256_testz_si256(lo, hi)) return false;
+
+		__m256i eq2F = _mm256_cmpeq_epi8(in, _mm256_set1_epi8(0x2f));
+		__m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+		in = _mm256_add_epi8(in, roll);
+
+		__m256i merged = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+		merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+
+		merged = _mm256_shuffle_epi8(merged, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+		out = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		return true;
+	}
+#endif
+}
+
+size_t Base64::binaryToTextSize(size_t byteCount)
+{
+	return (byteCount + 2) / 3 * 4;
+}
+
+size_t Base64::binaryToText(const void* from, size_t byteCount, char* to)
+{
+	const byte* it = (const byte*)from;
+	const byte* end = it + byteCount;
+	char* out = to;
+
+#if defined BASE64_USE_AVX2
+	// each block loads 16 bytes at it and at it + 12
+	while (end - it >= 28)
+	{
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)it)),
+			_mm_loadu_si128((const __m128i*)(it + 12)), 1);
+
+		_mm256_storeu_si256((__m256i*)out, EncodeBlock(in));
+
+		it += 24;
+		out += 32;
+	}
+#endif
+#if defined BASE64_USE_SSSE3
+	while (end - it >= 16)
+	{
+		_mm_storeu_si128((__m128i*)out, EncodeBlock(_mm_loadu_si128((const __m128i*)it)));
+
+		it += 12;
+		out += 16;
+	}
+#endif
+
+	while (end - it >= 3)
+	{
+		uint32_t int24bit = (uint32_t)it[0] << 16 | (uint32_t)it[1] << 8 | it[2];
+
+		out[0] = charTable[int24bit >> 18];
+		out[1] = charTable[(int24bit >> 12) & 0x3F];
+		out[2] = charTable[(int24bit >> 6) & 0x3F];
+		out[3] = charTable[int24bit & 0x3F];
+
+		it += 3;
+		out += 4;
+	}
+
+	if (it != end)
+	{
+		uint32_t int24bit = (uint32_t)it[0] << 16;
+		if (end - it == 2) int24bit |= (uint32_t)it[1] << 8;
+
+		out[0] = charTable[int24bit >> 18];
+		out[1] = charTable[(int24bit >> 12) & 0x3F];
+		out[2] = end - it == 2 ? charTable[(int24bit >> 6) & 0x3F] : '=';
+		out[3] = '=';
+
+		out += 4;
+	}
+
+	return out - to;
+}
+
+size_t Base64::textToBinarySize(size_t charCount)
+{
+	return (charCount + 3) / 4 * 3;
+}
+
+size_t Base64::textToBinary(const char* from, size_t charCount, void* to)
+{
+	const byte* it = (const byte*)from;
+	const byte* end = it + charCount;
+	byte* result = (byte*)to;
+
+	// Vector stores write a few bytes past the decoded block, so keep enough
+	// input left that those bytes still fall inside textToBinarySize().
+#if defined BASE64_USE_AVX2
+	while (end - it >= 44)
+	{
+		__m256i out;
+		if (!DecodeBlock(_mm256_loadu_si256((const __m256i*)it), out)) break;
+
+		_mm256_storeu_si256((__m256i*)result, out);
+
+		it += 32;
+		result += 24;
+	}
+#endif
+#if defined BASE64_USE_SSSE3
+	while (end - it >= 22)
+	{
+		__m128i out;
+		if (!DecodeBlock(_mm_loadu_si128((const __m128i*)it), out)) break;
+
+		_mm_storeu_si128((__m128i*)result, out);
+
+		it += 16;
+		result += 12;
+	}
+#endif
+
+	while (end - it >= 4 && it[3] != '=')
+	{
+		uint32_t int24bit = (uint32_t)byteTable[it[0]] << 18 | (uint32_t)byteTable[it[1]] << 12 |
+			(uint32_t)byteTable[it[2]] << 6 | byteTable[it[3]];
+
+		result[0] = (byte)(int24bit >> 16);
+		result[1] = (byte)(int24bit >> 8);
+		result[2] = (byte)int24bit;
+
+		it += 4;
+		result += 3;
+	}
+
+	// last group: padded or cut short
+	if (it != end)
+	{
+		uint32_t int24bit = 0;
+		int count = 0;
+
+		for (int i = 0; i < 4 && it != end; i++, it++)
+		{
+			if (*it == '=') continue;
+
+			int24bit |= (uint32_t)byteTable[*it] << ((3 - i) * 6);
+			count++;
+		}
+
+		for (int i = 0; i < count - 1; i++)
+		{
+			*result++ = (byte)(int24bit >> ((2 - i) * 8));
+		}
+	}
+
+	return result - (byte*)to;
+}
+
+#endif
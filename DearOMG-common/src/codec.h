@@ -0,0 +1,469 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+//=========================================================================
+// Integer stream codecs shared by the converters and the parser.
+//
+// An encoded stream is [codec tag (1 byte)][payload]. The inputs are
+// prefix sums, so the delta codecs store x[i] - x[i - 1]; EF is only a
+// candidate while the array is non-decreasing. Multi-byte fields are
+// little endian.
+//   CODEC_RAW          values, sizeof(ValueT) bytes each
+//   CODEC_EF           Elias-Fano words
+//   CODEC_PEF          partitioned Elias-Fano words
+//   CODEC_BP128        [n (8)][per block of 128 deltas: width (1), 4 interleaved lanes]
+//   CODEC_STREAMVBYTE  [n (8)][2-bit lengths, 4 per byte][1-4 byte deltas]
+//=========================================================================
+
+#include <string>
+#include <cstring>
+
+#include "eliasfano.h"
+
+enum CodecTag
+{
+	CODEC_RAW = 0,
+	CODEC_EF = 1,
+	CODEC_PEF = 2,
+	CODEC_BP128 = 3,
+	CODEC_STREAMVBYTE = 4
+};
+
+enum CodecPolicy
+{
+	CODEC_POLICY_SMALLEST = 0,  // fewest bytes before zstd
+	CODEC_POLICY_FASTEST = 1    // lowest estimated decode time
+};
+
+//=========================================================================
+// Little endian helpers
+//=========================================================================
+static inline void PutLE(std::vector<char>& out, uint64_t value, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		out.push_back((char)(value >> (8 * i)));
+	}
+}
+
+static inline uint64_t GetLE(const unsigned char* p, size_t bytes)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i)
+	{
+		value |= (uint64_t)p[i] << (8 * i);
+	}
+	return value;
+}
+
+template <typename WordT, typename ValueT = WordT>
+class IntegerCodecs
+{
+public:
+	struct Codec
+	{
+		uint8_t tag;
+		const char* name;
+
+		// rough decode time per value, in ns
+		double decodeCost;
+
+		// payload bytes, SIZE_MAX if the codec cannot hold x
+		size_t (*Size)(const std::vector<ValueT>& x);
+		void (*Encode)(const std::vector<ValueT>& x, std::vector<char>& out);
+		void (*Decode)(const unsigned char* data, size_t size, std::vector<ValueT>& x);
+	};
+
+	static const size_t BLOCK = 128;
+
+	// rough zstd + I/O time per stored byte, in ns
+	static double ByteCost() { return 0.5; }
+
+	static std::vector<Codec>& Registry()
+	{
+		static std::vector<Codec> codecs =
+		{
+			{ CODEC_RAW, "raw", 0.1, RawSize, RawEncode, RawDecode },
+			{ CODEC_EF, "ef", 1.0, EFSize, EFEncode, EFDecode },
+			{ CODEC_PEF, "pef", 1.4, PEFSize, PEFEncode, EFDecode },
+			{ CODEC_BP128, "bp128", 0.5, BP128Size, BP128Encode, BP128Decode },
+			{ CODEC_STREAMVBYTE, "streamvbyte", 0.6, StreamVByteSize, StreamVByteEncode, StreamVByteDecode }
+		};
+		return codecs;
+	}
+
+	// Adds a codec or replaces the one with the same tag.
+	static void Register(const Codec& codec)
+	{
+		std::vector<Codec>& codecs = Registry();
+
+		for (size_t i = 0; i < codecs.size(); ++i)
+		{
+			if (codecs[i].tag == codec.tag)
+			{
+				codecs[i] = codec;
+				return;
+			}
+		}
+		codecs.push_back(codec);
+	}
+
+	static const Codec* Find(uint8_t tag)
+	{
+		std::vector<Codec>& codecs = Registry();
+
+		for (size_t i = 0; i < codecs.size(); ++i)
+		{
+			if (codecs[i].tag == tag) return &codecs[i];
+		}
+		return NULL;
+	}
+
+	// The registered codec that suits x best under policy.
+	static const Codec& Choose(const std::vector<ValueT>& x, int policy)
+	{
+		std::vector<Codec>& codecs = Registry();
+
+		size_t best = 0;
+		double bestScore = -1.0;
+
+		for (size_t i = 0; i < codecs.size(); ++i)
+		{
+			size_t size = codecs[i].Size(x);
+			if (size == SIZE_MAX) continue;
+
+			double score = (double)size;
+			if (policy == CODEC_POLICY_FASTEST)
+			{
+				score = codecs[i].decodeCost * x.size() + ByteCost() * size;
+			}
+
+			if (bestScore < 0.0 || score < bestScore)
+			{
+				best = i;
+				bestScore = score;
+			}
+		}
+		return codecs[best];
+	}
+
+	// out = [tag][payload]
+	static void Encode(const std::vector<ValueT>& x, int policy, std::vector<char>& out)
+	{
+		const Codec& codec = Choose(x, policy);
+
+		out.clear();
+		out.push_back((char)codec.tag);
+		codec.Encode(x, out);
+	}
+
+	static void EncodeWith(const std::vector<ValueT>& x, uint8_t tag, std::vector<char>& out)
+	{
+		const Codec* codec = Find(tag);
+
+		if (codec == NULL)
+		{
+			std::cout << "[ERROR] Unknown integer codec tag: " << (int)tag << std::endl;
+			exit(1);
+		}
+
+		out.clear();
+		out.push_back((char)codec->tag);
+		codec->Encode(x, out);
+	}
+
+	static void Decode(const char* data, size_t size, std::vector<ValueT>& x)
+	{
+		if (size == 0)
+		{
+			x.clear();
+			return;
+		}
+
+		const Codec* codec = Find((uint8_t)data[0]);
+
+		if (codec == NULL)
+		{
+			std::cout << "[ERROR] Unknown integer codec tag: " << (int)(uint8_t)data[0] << std::endl;
+			exit(1);
+		}
+
+		codec->Decode((const unsigned char*)data + 1, size - 1, x);
+	}
+
+private:
+	// Decoders check every read against the stream size.
+	static void Corrupted(const char* name)
+	{
+		std::cout << "[ERROR] The " << name << " integer stream is corrupted!" << std::endl;
+		exit(1);
+	}
+
+	//=====================================================================
+	// Raw
+	//=====================================================================
+	static size_t RawSize(const std::vector<ValueT>& x)
+	{
+		return x.size() * sizeof(ValueT);
+	}
+
+	static void RawEncode(const std::vector<ValueT>& x, std::vector<char>& out)
+	{
+		for (size_t i = 0; i < x.size(); ++i) PutLE(out, x[i], sizeof(ValueT));
+	}
+
+	static void RawDecode(const unsigned char* data, size_t size, std::vector<ValueT>& x)
+	{
+		x.resize(size / sizeof(ValueT));
+		for (size_t i = 0; i < x.size(); ++i) x[i] = (ValueT)GetLE(data + i * sizeof(ValueT), sizeof(ValueT));
+	}
+
+	//=====================================================================
+	// Elias-Fano, plain and partitioned
+	//=====================================================================
+	static bool Sorted(const std::vector<ValueT>& x)
+	{
+		for (size_t i = 1; i < x.size(); ++i)
+		{
+			if (x[i] < x[i - 1]) return false;
+		}
+		return true;
+	}
+
+	static size_t EFSize(const std::vector<ValueT>& x)
+	{
+		if (!Sorted(x)) return SIZE_MAX;
+
+		return EliasFano<WordT, ValueT>::EncodeSize(x) * sizeof(WordT);
+	}
+
+	static void EFEncode(const std::vector<ValueT>& x, std::vector<char>& out)
+	{
+		EliasFano<WordT, ValueT>::EncodeBytes(x, out);
+	}
+
+	static size_t PEFSize(const std::vector<ValueT>& x)
+	{
+		if (!Sorted(x)) return SIZE_MAX;
+
+		std::vector<WordT> EFCode;
+		PartitionedEliasFano<WordT, ValueT>::Encode(x, EFCode);
+		return EFCode.size() * sizeof(WordT);
+	}
+
+	static void PEFEncode(const std::vector<ValueT>& x, std::vector<char>& out)
+	{
+		PartitionedEliasFano<WordT, ValueT>::EncodeBytes(x, out);
+	}
+
+	// plain and partitioned codes share the decoder
+	static void EFDecode(const unsigned char* data, size_t size, std::vector<ValueT>& x)
+	{
+		EliasFano<WordT, ValueT>::DecodeBytes((const char*)data, size, x);
+	}
+
+	//=====================================================================
+	// BP128: deltas in blocks of 128, each block packed with the bit width
+	// of its largest delta in the SIMD-BP128 layout: delta i of a block goes
+	// to lane i % 4, every lane is an LSB-first bit stream of 32-bit words,
+	// and word j of lane l is stored at 4 * j + l. A partial last block
+	// keeps the layout with shorter lanes.
+	//=====================================================================
+	static uint64_t BitWidth(uint64_t value)
+	{
+		return value == 0 ? 0 : 64 - EFLeadingZeros(value);
+	}
+
+	static uint64_t Delta(const std::vector<ValueT>& x, size_t i)
+	{
+		return i == 0 ? (uint64_t)x[0] : (uint64_t)(ValueT)(x[i] - x[i - 1]);
+	}
+
+	static uint64_t BlockWidth(const std::vector<ValueT>& x, size_t begin, size_t end)
+	{
+		uint64_t width = 0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			uint64_t w = BitWidth(Delta(x, i));
+			if (w > width) width = w;
+		}
+		return width;
+	}
+
+	// bytes of the 4 lanes of count deltas of width bits
+	static size_t LaneBytes(size_t count, uint64_t width)
+	{
+		return 4 * sizeof(uint32_t) * (size_t)(((count + 3) / 4 * width + 31) / 32);
+	}
+
+	static size_t BP128Size(const std::vector<ValueT>& x)
+	{
+		size_t size = 8;
+
+		for (size_t begin = 0; begin < x.size(); begin += BLOCK)
+		{
+			size_t end = begin + BLOCK < x.size() ? begin + BLOCK : x.size();
+			size += 1 + LaneBytes(end - begin, BlockWidth(x, begin, end));
+		}
+		return size;
+	}
+
+	static void BP128Encode(const std::vector<ValueT>& x, std::vector<char>& out)
+	{
+		PutLE(out, x.size(), 8);
+
+		std::vector<uint32_t> lanes;
+
+		for (size_t begin = 0; begin < x.size(); begin += BLOCK)
+		{
+			size_t end = begin + BLOCK < x.size() ? begin + BLOCK : x.size();
+
+			uint64_t width = BlockWidth(x, begin, end);
+			out.push_back((char)width);
+
+			if (width == 0) continue;
+
+			lanes.assign(LaneBytes(end - begin, width) / sizeof(uint32_t), 0);
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				uint64_t d = Delta(x, i);
+				size_t lane = (i - begin) % 4;
+				uint64_t bit = (i - begin) / 4 * width;
+
+				// a delta spans up to 3 words of its lane
+				for (uint64_t done = 0; done < width; )
+				{
+					uint64_t shift = (bit + done) % 32;
+					lanes[4 * (size_t)((bit + done) / 32) + lane] |= (uint32_t)((d >> done) << shift);
+					done += 32 - shift;
+				}
+			}
+
+			for (size_t k = 0; k < lanes.size(); ++k)
+			{
+				PutLE(out, lanes[k], sizeof(uint32_t));
+			}
+		}
+	}
+
+	static void BP128Decode(const unsigned char* data, size_t size, std::vector<ValueT>& x)
+	{
+		if (size < 8) Corrupted("bp128");
+
+		// every block takes at least its width byte
+		uint64_t n = GetLE(data, 8);
+		if ((n + BLOCK - 1) / BLOCK > size - 8) Corrupted("bp128");
+
+		x.resize((size_t)n);
+
+		size_t pos = 8;
+		ValueT prev = 0;
+
+		for (size_t begin = 0; begin < x.size(); begin += BLOCK)
+		{
+			size_t end = begin + BLOCK < x.size() ? begin + BLOCK : x.size();
+
+			if (pos >= size) Corrupted("bp128");
+			uint64_t width = data[pos++];
+
+			size_t blockBytes = LaneBytes(end - begin, width);
+			if (width > 64 || blockBytes > size - pos) Corrupted("bp128");
+
+			const unsigned char* block = data + pos;
+			for (size_t i = begin; i < end; ++i)
+			{
+				prev += (ValueT)ReadLane(block, (i - begin) % 4, (i - begin) / 4 * width, width);
+				x[i] = prev;
+			}
+			pos += blockBytes;
+		}
+	}
+
+	// width bits of a lane starting at bit
+	static uint64_t ReadLane(const unsigned char* block, size_t lane, uint64_t bit, uint64_t width)
+	{
+		uint64_t value = 0;
+
+		for (uint64_t done = 0; done < width; )
+		{
+			uint64_t shift = (bit + done) % 32;
+			uint64_t word = GetLE(block + sizeof(uint32_t) * (4 * (size_t)((bit + done) / 32) + lane), sizeof(uint32_t));
+
+			value |= (word >> shift) << done;
+			done += 32 - shift;
+		}
+
+		return width < 64 ? value & ((1ULL << width) - 1) : value;
+	}
+
+	//=====================================================================
+	// Stream VByte: deltas in 1-4 bytes, lengths kept apart as 2-bit codes
+	//=====================================================================
+	static size_t ByteLength(uint64_t d)
+	{
+		if (d < (1ULL << 8)) return 1;
+		if (d < (1ULL << 16)) return 2;
+		if (d < (1ULL << 24)) return 3;
+		return 4;
+	}
+
+	static size_t StreamVByteSize(const std::vector<ValueT>& x)
+	{
+		size_t size = 8 + (x.size() + 3) / 4;
+
+		for (size_t i = 0; i < x.size(); ++i)
+		{
+			uint64_t d = Delta(x, i);
+			if (d > 0xFFFFFFFFULL) return SIZE_MAX;
+
+			size += ByteLength(d);
+		}
+		return size;
+	}
+
+	static void StreamVByteEncode(const std::vector<ValueT>& x, std::vector<char>& out)
+	{
+		PutLE(out, x.size(), 8);
+
+		size_t control = out.size();
+		out.resize(control + (x.size() + 3) / 4, 0);
+
+		for (size_t i = 0; i < x.size(); ++i)
+		{
+			uint64_t d = Delta(x, i);
+			size_t len = ByteLength(d);
+
+			out[control + i / 4] |= (char)((len - 1) << (2 * (i % 4)));
+			PutLE(out, d, len);
+		}
+	}
+
+	static void StreamVByteDecode(const unsigned char* data, size_t size, std::vector<ValueT>& x)
+	{
+		if (size < 8) Corrupted("streamvbyte");
+
+		// every delta takes at least one byte
+		uint64_t n = GetLE(data, 8);
+		if (n > size - 8 || (n + 3) / 4 + n > size - 8) Corrupted("streamvbyte");
+
+		x.resize((size_t)n);
+
+		const unsigned char* control = data + 8;
+		const unsigned char* p = control + (x.size() + 3) / 4;
+		const unsigned char* stop = data + size;
+
+		ValueT prev = 0;
+		for (size_t i = 0; i < x.size(); ++i)
+		{
+			size_t len = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+			if (len > (size_t)(stop - p)) Corrupted("streamvbyte");
+
+			prev += (ValueT)GetLE(p, len);
+			x[i] = prev;
+			p += len;
+		}
+	}
+};
+
+#endif // !CODEC_H
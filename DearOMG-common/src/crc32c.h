@@ -0,0 +1,195 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+//=========================================================================
+// CRC32C (Castagnoli polynomial) of the block and footer checksums in
+// omgfooter.h. x86-64 CPUs with SSE4.2 run the crc32 instruction on three
+// interleaved streams, other CPUs fall back to slicing-by-8 tables.
+//=========================================================================
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CRC32C_X64
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#include <cpuid.h>
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#endif
+
+class CRC32C
+{
+public:
+	// CRC of data, continuing from crc when it is split over several calls.
+	static uint32_t Compute(const void* data, size_t size, uint32_t crc = 0)
+	{
+#ifdef CRC32C_X64
+		static const bool hardware = HasSSE42();
+		if (hardware)
+		{
+			return ~HardwareUpdate(~crc, (const unsigned char*)data, size);
+		}
+#endif
+		return ~SoftwareUpdate(~crc, (const unsigned char*)data, size);
+	}
+
+private:
+	struct Tables
+	{
+		uint32_t t[8][256];
+
+		Tables()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t crc = i;
+				for (int j = 0; j < 8; ++j)
+				{
+					crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+				}
+				t[0][i] = crc;
+			}
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				for (int k = 1; k < 8; ++k)
+				{
+					t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+				}
+			}
+		}
+	};
+
+	static uint32_t SoftwareUpdate(uint32_t crc, const unsigned char* p, size_t size)
+	{
+		static const Tables tables;
+		const uint32_t (*t)[256] = tables.t;
+
+		while (size >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			word ^= crc;
+
+			crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^
+				t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF] ^
+				t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^
+				t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+
+			p += 8;
+			size -= 8;
+		}
+		while (size-- > 0)
+		{
+			crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+		}
+
+		return crc;
+	}
+
+#ifdef CRC32C_X64
+	static bool HasSSE42()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+		return (ecx & bit_SSE4_2) != 0;
+#endif
+	}
+
+	// x^(8 * bytes) modulo the polynomial. Multiplying a stream's CRC by it
+	// shifts the CRC over the bytes of the streams that follow.
+	static uint32_t XPower(size_t bytes)
+	{
+		uint32_t x = 0x80000000; // x^0
+		uint32_t power = 0x40000000; // x^1
+		uint64_t bits = 8 * (uint64_t)bytes;
+
+		while (bits > 0)
+		{
+			if (bits & 1) x = Multiply(x, power);
+			power = Multiply(power, power);
+			bits >>= 1;
+		}
+
+		return x;
+	}
+
+	// Product of two polynomials in the reflected bit order of CRC32C.
+	static uint32_t Multiply(uint32_t a, uint32_t b)
+	{
+		uint32_t product = 0;
+		for (int i = 0; i < 32; ++i)
+		{
+			if (a & 0x80000000) product ^= b;
+			a <<= 1;
+			b = (b >> 1) ^ (0x82F63B78 & (0 - (b & 1)));
+		}
+
+		return product;
+	}
+
+	CRC32C_TARGET static uint32_t HardwareUpdate(uint32_t crc, const unsigned char* p, size_t size)
+	{
+		// crc32 has a latency of three cycles, three independent streams keep it busy
+		const size_t stripe = 8 * 1024;
+		static const uint32_t shift1 = XPower(stripe);
+		static const uint32_t shift2 = XPower(2 * stripe);
+
+		while (size >= 3 * stripe)
+		{
+			uint64_t crc0 = crc;
+			uint64_t crc1 = 0;
+			uint64_t crc2 = 0;
+
+			for (size_t i = 0; i < stripe; i += 8)
+			{
+				uint64_t w0, w1, w2;
+				memcpy(&w0, p + i, 8);
+				memcpy(&w1, p + stripe + i, 8);
+				memcpy(&w2, p + 2 * stripe + i, 8);
+
+				crc0 = _mm_crc32_u64(crc0, w0);
+				crc1 = _mm_crc32_u64(crc1, w1);
+				crc2 = _mm_crc32_u64(crc2, w2);
+			}
+
+			crc = Multiply((uint32_t)crc0, shift2) ^ Multiply((uint32_t)crc1, shift1) ^ (uint32_t)crc2;
+
+			p += 3 * stripe;
+			size -= 3 * stripe;
+		}
+
+		uint64_t crc64 = crc;
+		while (size >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, 8);
+			crc64 = _mm_crc32_u64(crc64, word);
+
+			p += 8;
+			size -= 8;
+		}
+
+		crc = (uint32_t)crc64;
+		while (size-- > 0)
+		{
+			crc = _mm_crc32_u8(crc, *p++);
+		}
+
+		return crc;
+	}
+#endif
+};
+
+
+#endif // !CRC32C_H
@@ -0,0 +1,1038 @@
+#ifndef ELIASFANO_H
+#define ELIASFANO_H
+
+//=========================================================================
+// Elias-Fano codec shared by DearOMG-community, DearOMG-vendor and
+// DearOMG-parser.
+//
+// Layout of an EF code of n non-decreasing values, in WordT words:
+//   [upper bits][lower bits][n][upperBits * 100 + Length]
+// Bits are filled from the MSB of each word. Every value contributes one
+// set bit to the upper bits (preceded by the zeros of its high part) and
+// a Length-bit field to the lower bits.
+//
+// When n or upperBits * 100 + Length does not fit one word, the trailer
+// is replaced by the versioned header (64-bit fields, high word first):
+//   [upper bits][lower bits][n][upperBits][Length][version * 100 + 97]
+//
+// In files the words are stored little endian.
+//=========================================================================
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined __BMI2__ || defined __AVX2__
+#include <immintrin.h>
+#define EF_USE_BMI2
+#endif
+
+// Pointer + length view over caller owned memory (the projects build as C++14).
+template <typename T>
+struct Span
+{
+	T* data;
+	size_t size;
+
+	Span(T* data, size_t size) : data(data), size(size) {}
+
+	template <typename Container, typename = decltype(std::declval<Container&>().data())>
+	Span(Container& c) : data(c.data()), size(c.size()) {}
+
+	T& operator[](size_t i) const { return data[i]; }
+};
+
+//=========================================================================
+// Bit helpers
+//=========================================================================
+static inline uint64_t EFLeadingZeros(uint32_t word)
+{
+#if defined _MSC_VER
+	unsigned long idx;
+	_BitScanReverse(&idx, word);
+	return 31 - idx;
+#else
+	return __builtin_clz(word);
+#endif
+}
+
+static inline uint64_t EFLeadingZeros(uint64_t word)
+{
+#if defined _MSC_VER
+	unsigned long idx;
+	_BitScanReverse64(&idx, word);
+	return 63 - idx;
+#else
+	return __builtin_clzll(word);
+#endif
+}
+
+static inline uint64_t EFPopCount(uint32_t word)
+{
+#if defined _MSC_VER
+	return __popcnt(word);
+#else
+	return __builtin_popcount(word);
+#endif
+}
+
+static inline uint64_t EFPopCount(uint64_t word)
+{
+#if defined _MSC_VER
+	return __popcnt64(word);
+#else
+	return __builtin_popcountll(word);
+#endif
+}
+
+// The lowest Length bits of value, 0 < Length <= word size.
+static inline uint32_t EFLowBits(uint32_t value, uint64_t Length)
+{
+#if defined EF_USE_BMI2
+	return _bzhi_u32(value, (unsigned int)Length);
+#else
+	return Length < 32 ? value & ((1u << Length) - 1) : value;
+#endif
+}
+
+static inline uint64_t EFLowBits(uint64_t value, uint64_t Length)
+{
+#if defined EF_USE_BMI2
+	return _bzhi_u64(value, (unsigned int)Length);
+#else
+	return Length < 64 ? value & ((1ULL << Length) - 1) : value;
+#endif
+}
+
+//=========================================================================
+// Byte streams: words are little endian. On little endian hosts an
+// aligned buffer is encoded into and decoded from in place.
+//=========================================================================
+static inline bool EFLittleEndian()
+{
+	const uint16_t probe = 1;
+	return *(const uint8_t*)&probe == 1;
+}
+
+template <typename WordT>
+static inline bool EFInPlace(const char* data)
+{
+	return EFLittleEndian() && (uintptr_t)data % alignof(WordT) == 0;
+}
+
+template <typename WordT>
+static inline void EFStoreWords(const WordT* words, size_t count, char* data)
+{
+	if (EFLittleEndian())
+	{
+		memcpy(data, words, count * sizeof(WordT));
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (size_t b = 0; b < sizeof(WordT); ++b)
+		{
+			data[i * sizeof(WordT) + b] = (char)(words[i] >> (8 * b));
+		}
+	}
+}
+
+template <typename WordT>
+static inline void EFLoadWords(const char* data, size_t count, WordT* words)
+{
+	if (EFLittleEndian())
+	{
+		memcpy(words, data, count * sizeof(WordT));
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		WordT word = 0;
+		for (size_t b = 0; b < sizeof(WordT); ++b)
+		{
+			word |= (WordT)((WordT)(uint8_t)data[i * sizeof(WordT) + b] << (8 * b));
+		}
+		words[i] = word;
+	}
+}
+
+// Words of a byte stream. scratch receives a copy only when the bytes
+// cannot be read in place.
+template <typename WordT>
+static inline Span<const WordT> EFWordView(const char* data, size_t size, std::vector<WordT>& scratch)
+{
+	size_t count = size / sizeof(WordT);
+
+	if (EFInPlace<WordT>(data)) return Span<const WordT>((const WordT*)data, count);
+
+	scratch.resize(count);
+	EFLoadWords(data, count, scratch.data());
+
+	return Span<const WordT>(scratch.data(), count);
+}
+
+//=========================================================================
+// Encoder / decoder
+//=========================================================================
+template <typename WordT, typename ValueT = WordT>
+class EliasFano
+{
+	static_assert(sizeof(WordT) == 4 || sizeof(WordT) == 8, "EF words are 32 or 64 bits");
+
+public:
+	static const uint64_t WORD_BITS = sizeof(WordT) * 8;
+
+	// Trailer tags beyond the Length range (Length <= 64).
+	static const uint64_t HEADER_TAG = 97;      // versioned header with 64-bit fields
+	static const uint64_t BITMAP_TAG = 98;      // [bitmap][n][universe * 100 + 98]
+	static const uint64_t PARTITION_TAG = 99;   // [chunks][base, end per chunk][n][chunkCount * 100 + 99]
+
+	static const uint64_t HEADER_VERSION = 2;
+
+	// Fields read from the end of a code. For bitmap and partitioned codes
+	// Length holds the tag and upperBits the universe or the chunk count.
+	struct Trailer
+	{
+		uint64_t n;
+		uint64_t upperBits;
+		uint64_t Length;
+		size_t words;
+	};
+
+	static Trailer ReadTrailer(Span<const WordT> EFCode)
+	{
+		Trailer t;
+
+		uint64_t last = EFCode[EFCode.size - 1];
+
+		if (last % 100 != HEADER_TAG)
+		{
+			t.n = EFCode[EFCode.size - 2];
+			t.upperBits = last / 100;
+			t.Length = last % 100;
+			t.words = 2;
+			return t;
+		}
+
+		if (last / 100 != HEADER_VERSION)
+		{
+			std::cout << "[ERROR] Unsupported EF header version: " << last / 100 << std::endl;
+			exit(1);
+		}
+
+		t.words = 1 + 3 * FIELD_WORDS;
+
+		size_t pos = EFCode.size - t.words;
+		t.n = ReadField(EFCode, pos);
+		t.upperBits = ReadField(EFCode, pos + FIELD_WORDS);
+		t.Length = ReadField(EFCode, pos + 2 * FIELD_WORDS);
+
+		return t;
+	}
+
+	// Number of lower bits per value.
+	static uint64_t LowerLength(uint64_t n, uint64_t U)
+	{
+		if (U <= n) return 0;
+
+		return (uint64_t)(std::ceil(std::log2((float)U / n))); // Length = int( log2[U/n] )
+	}
+
+	// Words needed to encode x, trailer included.
+	static size_t EncodeSize(Span<const ValueT> x)
+	{
+		if (x.size == 0) return 2;
+
+		return EncodeSize(x.size, (uint64_t)x[x.size - 1]);
+	}
+
+	// Words needed for n values whose largest is U.
+	static size_t EncodeSize(uint64_t n, uint64_t U)
+	{
+		uint64_t Length = LowerLength(n, U);
+		uint64_t space = n * (Length + 2);
+
+		return (size_t)((space + WORD_BITS - 1) / WORD_BITS) + TrailerSize(n, n + (U >> Length), Length);
+	}
+
+	// Encode x into EFCode, which must hold EncodeSize(x) words.
+	// Nothing is allocated; returns the number of words written.
+	static size_t Encode(Span<const ValueT> x, Span<WordT> EFCode)
+	{
+		uint64_t n = x.size;
+		uint64_t Length = n > 0 ? LowerLength(n, x[n - 1]) : 0;
+
+		size_t m = n > 0 ? (size_t)((n * (Length + 2) + WORD_BITS - 1) / WORD_BITS) : 0;
+		for (size_t i = 0; i < m; ++i) EFCode[i] = 0;
+
+		uint64_t bitIdx = 0;
+		uint64_t prevHigh = 0;
+
+		for (uint64_t i = 0; i < n; ++i)
+		{
+			uint64_t high = (uint64_t)x[i] >> Length;
+
+			bitIdx += high - prevHigh;
+			prevHigh = high;
+
+			EFCode[bitIdx / WORD_BITS] |= (WordT)((WordT)1 << (WORD_BITS - 1 - (bitIdx % WORD_BITS)));
+
+			++bitIdx;
+		}
+
+		uint64_t upperBits = bitIdx;
+
+		if (Length > 0)
+		{
+			// lower bits: the whole Length-bit field goes in with one OR, or two when it straddles a word.
+			for (uint64_t i = 0; i < n; ++i)
+			{
+				WordT mod = EFLowBits((WordT)x[i], Length);
+
+				uint64_t w = bitIdx / WORD_BITS;
+				uint64_t o = bitIdx % WORD_BITS;
+
+				if (o + Length <= WORD_BITS)
+				{
+					EFCode[w] |= (WordT)(mod << (WORD_BITS - o - Length));
+				}
+				else
+				{
+					EFCode[w] |= (WordT)(mod >> (o + Length - WORD_BITS));
+					EFCode[w + 1] |= (WordT)(mod << (2 * WORD_BITS - o - Length));
+				}
+
+				bitIdx += Length;
+			}
+		}
+
+		if (TrailerSize(n, upperBits, Length) == 2)
+		{
+			EFCode[m] = (WordT)n;
+			EFCode[m + 1] = (WordT)(upperBits * 100 + Length);
+
+			return m + 2;
+		}
+
+		WriteField(EFCode, m, n);
+		WriteField(EFCode, m + FIELD_WORDS, upperBits);
+		WriteField(EFCode, m + 2 * FIELD_WORDS, Length);
+		EFCode[m + 3 * FIELD_WORDS] = (WordT)(HEADER_VERSION * 100 + HEADER_TAG);
+
+		return m + 1 + 3 * FIELD_WORDS;
+	}
+
+	static void Encode(const std::vector<ValueT>& x, std::vector<WordT>& EFCode)
+	{
+		EFCode.resize(EncodeSize(x));
+		Encode(Span<const ValueT>(x), Span<WordT>(EFCode));
+	}
+
+	// Append the code of x to out as little endian bytes.
+	static void EncodeBytes(Span<const ValueT> x, std::vector<char>& out)
+	{
+		size_t offset = out.size();
+		size_t words = EncodeSize(x);
+
+		out.resize(offset + words * sizeof(WordT));
+		char* data = out.data() + offset;
+
+		if (EFInPlace<WordT>(data))
+		{
+			Encode(x, Span<WordT>((WordT*)data, words));
+			return;
+		}
+
+		std::vector<WordT> EFCode(words);
+		Encode(x, Span<WordT>(EFCode));
+		EFStoreWords(EFCode.data(), words, data);
+	}
+
+	// Number of values stored in an EF code.
+	static size_t DecodeSize(Span<const WordT> EFCode)
+	{
+		return (size_t)ReadTrailer(EFCode).n;
+	}
+
+	// Decode EFCode into x, which must hold DecodeSize(EFCode) values.
+	// Partitioned codes and bitmap chunks are recognised by their trailer tag.
+	static void Decode(Span<const WordT> EFCode, Span<ValueT> x)
+	{
+		Trailer t = ReadTrailer(EFCode);
+
+		if (t.Length == PARTITION_TAG)
+		{
+			DecodePartitioned(EFCode, x);
+			return;
+		}
+		if (t.Length == BITMAP_TAG)
+		{
+			DecodeBitmap(EFCode, x);
+			return;
+		}
+
+		uint64_t n = t.n;
+
+		uint64_t Length = t.Length;
+		uint64_t upperBits = t.upperBits;
+
+		// upper bits: every set bit is one element, the zeros before it are its high part.
+		// Walk whole words and jump from one set bit to the next with lzcnt.
+		uint64_t i = 0;
+		uint64_t upperWords = (upperBits + WORD_BITS - 1) / WORD_BITS;
+
+		for (uint64_t w = 0; w < upperWords && i < n; ++w)
+		{
+			WordT word = EFCode[w];
+
+			uint64_t validBits = upperBits - w * WORD_BITS;
+			if (validBits < WORD_BITS) word &= (WordT)~((WordT)~(WordT)0 >> validBits);
+
+			while (word != 0 && i < n)
+			{
+				uint64_t lz = EFLeadingZeros(word);
+				word ^= (WordT)(TOP_BIT >> lz);
+
+				x[i] = (ValueT)((w * WORD_BITS + lz - i) << Length);
+				++i;
+			}
+		}
+
+		if (Length == 0) return;
+
+		// lower bits: Length-bit fields packed MSB-first right after the upper bits.
+		uint64_t lowerIdx = upperBits;
+
+		for (uint64_t k = 0; k < n; ++k)
+		{
+			x[k] += (ValueT)LowerField(EFCode.data, lowerIdx, Length);
+			lowerIdx += Length;
+		}
+	}
+
+	static void Decode(const std::vector<WordT>& EFCode, std::vector<ValueT>& x)
+	{
+		x.resize(DecodeSize(EFCode));
+		Decode(Span<const WordT>(EFCode), Span<ValueT>(x));
+	}
+
+	// Decode a little endian byte stream written by EncodeBytes.
+	static void DecodeBytes(const char* data, size_t size, std::vector<ValueT>& x)
+	{
+		std::vector<WordT> scratch;
+		Span<const WordT> EFCode = EFWordView(data, size, scratch);
+
+		x.resize(DecodeSize(EFCode));
+		Decode(EFCode, Span<ValueT>(x));
+	}
+
+	// Length-bit field starting at bit position bit (MSB-first), spanning at most two words.
+	static uint64_t LowerField(const WordT* EFCode, uint64_t bit, uint64_t Length)
+	{
+		uint64_t w = bit / WORD_BITS;
+		uint64_t o = bit % WORD_BITS;
+
+		uint64_t field = (uint64_t)(WordT)(EFCode[w] << o) >> (WORD_BITS - Length);
+
+		if (o + Length > WORD_BITS)
+		{
+			field |= (uint64_t)EFCode[w + 1] >> (2 * WORD_BITS - o - Length);
+		}
+
+		return field;
+	}
+
+private:
+	static const WordT TOP_BIT = (WordT)((WordT)1 << (WORD_BITS - 1));
+	static const size_t FIELD_WORDS = 8 / sizeof(WordT);
+
+	// 2 for the legacy trailer, more when its fields overflow a word
+	static size_t TrailerSize(uint64_t n, uint64_t upperBits, uint64_t Length)
+	{
+		uint64_t maxWord = (WordT)~(WordT)0;
+
+		if (n <= maxWord && upperBits <= (maxWord - Length) / 100) return 2;
+
+		return 1 + 3 * FIELD_WORDS;
+	}
+
+	static void WriteField(Span<WordT> EFCode, size_t pos, uint64_t value)
+	{
+		for (size_t i = 0; i < FIELD_WORDS; ++i)
+		{
+			EFCode[pos + i] = (WordT)(value >> (WORD_BITS * (FIELD_WORDS - 1 - i)));
+		}
+	}
+
+	static uint64_t ReadField(Span<const WordT> EFCode, size_t pos)
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < FIELD_WORDS; ++i)
+		{
+			value = (value << (WORD_BITS % 64)) | EFCode[pos + i];
+		}
+		return value;
+	}
+
+	// every set bit of the bitmap is one element, its position is the value
+	static void DecodeBitmap(Span<const WordT> EFCode, Span<ValueT> x)
+	{
+		uint64_t n = EFCode[EFCode.size - 2];
+		uint64_t bits = EFCode[EFCode.size - 1] / 100 + 1;
+
+		uint64_t i = 0;
+		uint64_t words = (bits + WORD_BITS - 1) / WORD_BITS;
+
+		for (uint64_t w = 0; w < words && i < n; ++w)
+		{
+			WordT word = EFCode[w];
+
+			while (word != 0 && i < n)
+			{
+				uint64_t lz = EFLeadingZeros(word);
+				word ^= (WordT)(TOP_BIT >> lz);
+
+				x[i++] = (ValueT)(w * WORD_BITS + lz);
+			}
+		}
+	}
+
+	static void DecodePartitioned(Span<const WordT> EFCode, Span<ValueT> x)
+	{
+		uint64_t chunkCount = EFCode[EFCode.size - 1] / 100;
+		uint64_t header = EFCode.size - 2 - 2 * chunkCount;
+
+		uint64_t begin = 0;
+		uint64_t k = 0;
+
+		for (uint64_t c = 0; c < chunkCount; ++c)
+		{
+			ValueT base = (ValueT)EFCode[header + 2 * c];
+			uint64_t end = EFCode[header + 2 * c + 1];
+
+			Span<const WordT> chunk(EFCode.data + begin, (size_t)(end - begin));
+			Span<ValueT> out(x.data + k, DecodeSize(chunk));
+
+			Decode(chunk, out);
+			for (size_t i = 0; i < out.size; ++i) out[i] += base;
+
+			k += out.size;
+			begin = end;
+		}
+	}
+};
+
+//=========================================================================
+// Partitioned Elias-Fano.
+// The sequence is cut into chunks at GRANULE-aligned boundaries chosen by
+// a shortest-path over the encoded size. Every chunk is rebased on its
+// first value and stored as a plain EF code or, when cheaper, as a dense
+// bitmap. Sequences that do not gain from partitioning are written as a
+// plain EF code, so EliasFano::Decode reads either output.
+//=========================================================================
+template <typename WordT, typename ValueT = WordT>
+class PartitionedEliasFano
+{
+public:
+	static const uint64_t GRANULE = 64;
+	static const uint64_t MAX_GRANULES = 64;    // longest chunk, in granules
+
+	static void Encode(const std::vector<ValueT>& x, std::vector<WordT>& EFCode)
+	{
+		size_t n = x.size();
+		size_t plainSize = EF::EncodeSize(x);
+
+		// strictly increasing runs are required for bitmap chunks
+		std::vector<uint64_t> dups(n + 1, 0);
+		for (size_t i = 1; i < n; ++i)
+		{
+			dups[i + 1] = dups[i] + (x[i] == x[i - 1] ? 1 : 0);
+		}
+
+		// cost[t]: fewest words for the first t granules, including the 2-word header entry per chunk
+		size_t granules = (n + GRANULE - 1) / GRANULE;
+
+		std::vector<uint64_t> cost(granules + 1, 0);
+		std::vector<size_t> from(granules + 1, 0);
+
+		for (size_t t = 1; t <= granules; ++t)
+		{
+			cost[t] = UINT64_MAX;
+
+			size_t end = t * GRANULE < n ? t * GRANULE : n;
+			for (size_t s = t > MAX_GRANULES ? t - MAX_GRANULES : 0; s < t; ++s)
+			{
+				bool bitmap;
+				uint64_t c = cost[s] + ChunkSize(x, dups, s * GRANULE, end, bitmap) + 2;
+
+				if (c < cost[t])
+				{
+					cost[t] = c;
+					from[t] = s;
+				}
+			}
+		}
+
+		// chunkCount * 100 + 99 must fit the trailer word
+		if (granules <= 1 || granules > MAX_CHUNKS || cost[granules] + 2 >= plainSize)
+		{
+			EF::Encode(x, EFCode);
+			return;
+		}
+
+		std::vector<size_t> bounds;
+		for (size_t t = granules; t > 0; t = from[t])
+		{
+			bounds.push_back(t * GRANULE < n ? t * GRANULE : n);
+		}
+		bounds.push_back(0);
+		std::reverse(bounds.begin(), bounds.end());
+
+		size_t chunkCount = bounds.size() - 1;
+
+		EFCode.assign((size_t)cost[granules] + 2, 0);
+
+		std::vector<ValueT> rebased;
+		size_t offset = 0;
+		size_t header = EFCode.size() - 2 - 2 * chunkCount;
+
+		for (size_t c = 0; c < chunkCount; ++c)
+		{
+			size_t begin = bounds[c];
+			size_t end = bounds[c + 1];
+
+			ValueT base = x[begin];
+
+			bool bitmap;
+			size_t words = (size_t)ChunkSize(x, dups, begin, end, bitmap);
+
+			if (bitmap)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					uint64_t bit = (uint64_t)(x[i] - base);
+					EFCode[offset + bit / WORD_BITS] |= (WordT)((WordT)1 << (WORD_BITS - 1 - bit % WORD_BITS));
+				}
+				EFCode[offset + words - 2] = (WordT)(end - begin);
+				EFCode[offset + words - 1] = (WordT)((uint64_t)(x[end - 1] - base) * 100 + EF::BITMAP_TAG);
+			}
+			else
+			{
+				rebased.resize(end - begin);
+				for (size_t i = begin; i < end; ++i) rebased[i - begin] = x[i] - base;
+
+				EF::Encode(Span<const ValueT>(rebased), Span<WordT>(EFCode.data() + offset, words));
+			}
+
+			offset += words;
+
+			EFCode[header + 2 * c] = (WordT)base;
+			EFCode[header + 2 * c + 1] = (WordT)offset;
+		}
+
+		EFCode[EFCode.size() - 2] = (WordT)n;
+		EFCode[EFCode.size() - 1] = (WordT)(chunkCount * 100 + EF::PARTITION_TAG);
+	}
+
+	// Append the code of x to out as little endian bytes.
+	static void EncodeBytes(const std::vector<ValueT>& x, std::vector<char>& out)
+	{
+		std::vector<WordT> EFCode;
+		Encode(x, EFCode);
+
+		size_t offset = out.size();
+		out.resize(offset + EFCode.size() * sizeof(WordT));
+
+		EFStoreWords(EFCode.data(), EFCode.size(), out.data() + offset);
+	}
+
+private:
+	typedef EliasFano<WordT, ValueT> EF;
+
+	static const uint64_t WORD_BITS = sizeof(WordT) * 8;
+	static const uint64_t MAX_CHUNKS = ((WordT)~(WordT)0 - EF::PARTITION_TAG) / 100;
+
+	// words of the cheaper encoding of x[begin, end)
+	static uint64_t ChunkSize(const std::vector<ValueT>& x, const std::vector<uint64_t>& dups,
+		size_t begin, size_t end, bool& bitmap)
+	{
+		uint64_t count = end - begin;
+		uint64_t universe = (uint64_t)(x[end - 1] - x[begin]);
+
+		uint64_t efSize = EF::EncodeSize(count, universe);
+
+		bitmap = false;
+		if (dups[end] - dups[begin + 1] != 0) return efSize;
+
+		uint64_t bitmapSize = (universe + 1 + WORD_BITS - 1) / WORD_BITS + 2;
+		if (bitmapSize >= efSize) return efSize;
+
+		bitmap = true;
+		return bitmapSize;
+	}
+};
+
+//=========================================================================
+// Random access over a single EF code or bitmap chunk.
+// The position of every SELECT_STEP-th one and zero of the upper bits is
+// sampled once, so that Access(k) and NextGEQ(value) only touch a few
+// words instead of decoding the whole array.
+//=========================================================================
+template <typename WordT>
+class EliasFanoPartIndex
+{
+public:
+	static const uint64_t SELECT_STEP = 256;
+
+	EliasFanoPartIndex(Span<const WordT> EFCode)
+	{
+		code = EFCode.data;
+
+		typename EliasFano<WordT>::Trailer t = EliasFano<WordT>::ReadTrailer(EFCode);
+
+		n = t.n;
+		Length = t.Length;
+		upperBits = t.upperBits;
+
+		// a bitmap is an upper-bits array whose positions are the values themselves
+		rankShift = 1;
+		if (Length == EliasFano<WordT>::BITMAP_TAG)
+		{
+			Length = 0;
+			upperBits += 1;
+			rankShift = 0;
+		}
+
+		uint64_t count1 = 0;
+		uint64_t count0 = 0;
+
+		uint64_t upperWords = (upperBits + WORD_BITS - 1) / WORD_BITS;
+
+		for (uint64_t w = 0; w < upperWords; ++w)
+		{
+			WordT word = UpperWord(w);
+			uint64_t ones = EFPopCount(word);
+			uint64_t zeros = ValidBits(w) - ones;
+
+			// a sample point falls into this word
+			while (onePtr.size() * SELECT_STEP < count1 + ones)
+			{
+				uint64_t r = onePtr.size() * SELECT_STEP - count1;
+				onePtr.push_back(w * WORD_BITS + SelectInWord(word, r));
+			}
+
+			while (zeroPtr.size() * SELECT_STEP < count0 + zeros)
+			{
+				uint64_t r = zeroPtr.size() * SELECT_STEP - count0;
+				zeroPtr.push_back(w * WORD_BITS + SelectInWord(ZeroWord(w), r));
+			}
+
+			count1 += ones;
+			count0 += zeros;
+		}
+	}
+
+	uint64_t Size() const
+	{
+		return n;
+	}
+
+	// The k-th element, 0 <= k < Size().
+	uint64_t Access(uint64_t k) const
+	{
+		uint64_t pos = Select1(k);
+
+		return ((pos - k * rankShift) << Length) | LowerBits(k);
+	}
+
+	// Index of the first element >= value, Size() if there is none.
+	uint64_t NextGEQ(uint64_t value) const
+	{
+		if (rankShift == 0) return BitmapNextGEQ(value);
+
+		uint64_t high = value >> Length;
+		uint64_t zeros = upperBits - n;
+
+		if (high > zeros) return n;
+
+		uint64_t pos = 0;
+		uint64_t k = 0;
+
+		if (high > 0)
+		{
+			pos = Select0(high - 1) + 1;
+			k = pos - high;
+		}
+
+		// elements sharing the high part are consecutive ones, compare their lower bits
+		for (; k < n; ++k, ++pos)
+		{
+			pos = NextOne(pos);
+
+			uint64_t x = ((pos - k) << Length) | LowerBits(k);
+			if (x >= value) return k;
+		}
+
+		return n;
+	}
+
+	// Decode elements [begin, end) into x[0, end - begin) plus base, walking the upper bits sequentially.
+	template <typename ValueT>
+	void Range(uint64_t begin, uint64_t end, ValueT* x, uint64_t base) const
+	{
+		if (end <= begin) return;
+
+		uint64_t pos = Select1(begin);
+
+		for (uint64_t k = begin; k < end; ++k, ++pos)
+		{
+			pos = NextOne(pos);
+			x[k - begin] = (ValueT)(base + (((pos - k * rankShift) << Length) | LowerBits(k)));
+		}
+	}
+
+private:
+	static const uint64_t WORD_BITS = sizeof(WordT) * 8;
+	static const WordT ALL_ONES = (WordT)(~(WordT)0);
+	static const WordT TOP_BIT = (WordT)((WordT)1 << (WORD_BITS - 1));
+
+	const WordT* code;
+
+	uint64_t n;
+	uint64_t Length;
+	uint64_t upperBits;
+	uint64_t rankShift;
+
+	std::vector<uint64_t> onePtr;
+	std::vector<uint64_t> zeroPtr;
+
+	uint64_t ValidBits(uint64_t w) const
+	{
+		uint64_t rest = upperBits - w * WORD_BITS;
+		return rest < WORD_BITS ? rest : WORD_BITS;
+	}
+
+	// upper word w with the bits that belong to the lower region cleared
+	WordT UpperWord(uint64_t w) const
+	{
+		uint64_t valid = ValidBits(w);
+		if (valid == WORD_BITS) return code[w];
+
+		return code[w] & (WordT)~(ALL_ONES >> valid);
+	}
+
+	WordT ZeroWord(uint64_t w) const
+	{
+		uint64_t valid = ValidBits(w);
+		if (valid == WORD_BITS) return (WordT)~code[w];
+
+		return (WordT)~code[w] & (WordT)~(ALL_ONES >> valid);
+	}
+
+	// bit offset (from the MSB) of the r-th set bit of word
+	static uint64_t SelectInWord(WordT word, uint64_t r)
+	{
+		for (uint64_t i = 0; i < r; ++i)
+		{
+			word ^= (WordT)(TOP_BIT >> EFLeadingZeros(word));
+		}
+		return EFLeadingZeros(word);
+	}
+
+	// position of the set bit with rank r, starting from the sampled pointer
+	uint64_t Select1(uint64_t r) const
+	{
+		uint64_t pos = onePtr[r / SELECT_STEP];
+		r %= SELECT_STEP;
+
+		uint64_t w = pos / WORD_BITS;
+		WordT word = UpperWord(w) & (WordT)(ALL_ONES >> (pos % WORD_BITS));
+
+		uint64_t ones = EFPopCount(word);
+		while (r >= ones)
+		{
+			r -= ones;
+			word = UpperWord(++w);
+			ones = EFPopCount(word);
+		}
+
+		return w * WORD_BITS + SelectInWord(word, r);
+	}
+
+	uint64_t Select0(uint64_t r) const
+	{
+		uint64_t pos = zeroPtr[r / SELECT_STEP];
+		r %= SELECT_STEP;
+
+		uint64_t w = pos / WORD_BITS;
+		WordT word = ZeroWord(w) & (WordT)(ALL_ONES >> (pos % WORD_BITS));
+
+		uint64_t zeros = EFPopCount(word);
+		while (r >= zeros)
+		{
+			r -= zeros;
+			word = ZeroWord(++w);
+			zeros = EFPopCount(word);
+		}
+
+		return w * WORD_BITS + SelectInWord(word, r);
+	}
+
+	// first set bit at or after pos
+	uint64_t NextOne(uint64_t pos) const
+	{
+		uint64_t w = pos / WORD_BITS;
+		WordT word = UpperWord(w) & (WordT)(ALL_ONES >> (pos % WORD_BITS));
+
+		while (word == 0)
+		{
+			word = UpperWord(++w);
+		}
+
+		return w * WORD_BITS + EFLeadingZeros(word);
+	}
+
+	uint64_t LowerBits(uint64_t k) const
+	{
+		if (Length == 0) return 0;
+
+		return EliasFano<WordT>::LowerField(code, upperBits + k * Length, Length);
+	}
+
+	// bitmaps have no sampled zeros to jump with, bisect over Access instead
+	uint64_t BitmapNextGEQ(uint64_t value) const
+	{
+		uint64_t lo = 0;
+		uint64_t hi = n;
+
+		while (lo < hi)
+		{
+			uint64_t mid = lo + (hi - lo) / 2;
+
+			if (Access(mid) < value) lo = mid + 1;
+			else hi = mid;
+		}
+
+		return lo;
+	}
+};
+
+//=========================================================================
+// Random access over an EF code, plain or partitioned.
+// A partitioned code keeps one EliasFanoPartIndex per chunk; lookups
+// first pick the chunk from the cumulative counts or the chunk bounds.
+//=========================================================================
+template <typename WordT>
+class EliasFanoIndex
+{
+public:
+	EliasFanoIndex(Span<const WordT> EFCode)
+	{
+		typename EliasFano<WordT>::Trailer t = EliasFano<WordT>::ReadTrailer(EFCode);
+
+		n = t.n;
+
+		if (t.Length != EliasFano<WordT>::PARTITION_TAG)
+		{
+			AddPart(EFCode, 0, 0);
+			return;
+		}
+
+		uint64_t chunkCount = t.upperBits;
+		uint64_t header = EFCode.size - 2 - 2 * chunkCount;
+
+		uint64_t begin = 0;
+		uint64_t first = 0;
+
+		for (uint64_t c = 0; c < chunkCount; ++c)
+		{
+			uint64_t end = EFCode[header + 2 * c + 1];
+
+			Span<const WordT> chunk(EFCode.data + begin, (size_t)(end - begin));
+			AddPart(chunk, EFCode[header + 2 * c], first);
+
+			first += parts.back().Size();
+			begin = end;
+		}
+	}
+
+	uint64_t Size() const
+	{
+		return n;
+	}
+
+	// The k-th element, 0 <= k < Size().
+	uint64_t Access(uint64_t k) const
+	{
+		size_t p = PartOf(k);
+
+		return bases[p] + parts[p].Access(k - firsts[p]);
+	}
+
+	// Index of the first element >= value, Size() if there is none.
+	uint64_t NextGEQ(uint64_t value) const
+	{
+		size_t p = std::lower_bound(lasts.begin(), lasts.end(), value) - lasts.begin();
+
+		if (p == parts.size()) return n;
+		if (value <= bases[p]) return firsts[p];
+
+		return firsts[p] + parts[p].NextGEQ(value - bases[p]);
+	}
+
+	// Decode elements [begin, end) into x.
+	template <typename ValueT>
+	void Range(uint64_t begin, uint64_t end, std::vector<ValueT>& x) const
+	{
+		x.resize(end > begin ? end - begin : 0);
+
+		for (uint64_t k = begin; k < end; )
+		{
+			size_t p = PartOf(k);
+
+			uint64_t partEnd = firsts[p] + parts[p].Size();
+			uint64_t stop = end < partEnd ? end : partEnd;
+
+			parts[p].Range(k - firsts[p], stop - firsts[p], x.data() + (k - begin), bases[p]);
+			k = stop;
+		}
+	}
+
+private:
+	uint64_t n;
+
+	std::vector<EliasFanoPartIndex<WordT>> parts;
+	std::vector<uint64_t> bases;
+	std::vector<uint64_t> firsts;
+	std::vector<uint64_t> lasts;
+
+	void AddPart(Span<const WordT> chunk, uint64_t base, uint64_t first)
+	{
+		parts.push_back(EliasFanoPartIndex<WordT>(chunk));
+
+		uint64_t size = parts.back().Size();
+
+		bases.push_back(base);
+		firsts.push_back(first);
+		lasts.push_back(size > 0 ? base + parts.back().Access(size - 1) : base);
+	}
+
+	size_t PartOf(uint64_t k) const
+	{
+		return std::upper_bound(firsts.begin(), firsts.end(), k) - firsts.begin() - 1;
+	}
+};
+
+#endif // !ELIASFANO_H
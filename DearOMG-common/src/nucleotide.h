@@ -0,0 +1,296 @@
+#ifndef NUCLEOTIDE_H
+#define NUCLEOTIDE_H
+
+//=========================================================================
+// 2-bit nucleotide codec of the genomics "seq" stream, shared by
+// DearOMG-community and DearOMG-parser.
+//
+// A: 00, T: 01, G: 10, C: 11, four bases per byte, the first base in the
+// two high bits. Any other character is stored as A and its position
+// returned, for the "npos" stream that restores it as N.
+//
+// Whole blocks go through SSSE3 (16 bases <-> 4 bytes) or AVX2
+// (32 bases <-> 8 bytes) when the build enables them; the rest takes the
+// scalar path. Both write into buffers the caller sized.
+//=========================================================================
+
+#include <vector>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined __AVX2__
+#include <immintrin.h>
+#define NUCLEOTIDE_USE_AVX2
+#define NUCLEOTIDE_USE_SSSE3
+#elif defined __SSSE3__
+#include <tmmintrin.h>
+#define NUCLEOTIDE_USE_SSSE3
+#endif
+
+namespace Nucleotide
+{
+	typedef unsigned char byte;
+
+	static const char baseTable[4] = { 'A', 'T', 'G', 'C' };
+
+	// 2-bit code of each character, 4 for the characters stored as N
+	static const byte codeTable[256] =
+	{
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 0, 4, 3, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 1, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+	};
+
+	size_t packedSize(size_t baseCount);
+	size_t pack(const char* from, size_t baseCount, void* to, std::vector<uint32_t>& NBasePos);
+	void unpack(const void* from, size_t baseCount, char* to);
+
+#if defined NUCLEOTIDE_USE_SSSE3
+	// 16 characters to their codes, one per byte; bit j of invalid is set
+	// when character j is no A, T, G or C
+	static inline __m128i EncodeLookup(__m128i in, int& invalid)
+	{
+		// A, C, G and T differ in the low nibble: 1, 3, 7 and 4; slot 0 holds -1,
+		// which no byte looks up, so that '\0' is no match and is stored as N
+		const __m128i charLUT = _mm_setr_epi8(-1, 'A', 0, 'C', 'T', 0, 0, 'G', 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m128i codeLUT = _mm_setr_epi8(0, 0, 0, 3, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+
+		__m128i loNibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+		__m128i valid = _mm_cmpeq_epi8(in, _mm_shuffle_epi8(charLUT, loNibbles));
+
+		invalid = ~_mm_movemask_epi8(valid) & 0xFFFF;
+		return _mm_and_si128(_mm_shuffle_epi8(codeLUT, loNibbles), valid);
+	}
+
+	// 16 codes to 4 bytes in the low dword
+	static inline __m128i PackCodes(__m128i codes)
+	{
+		// c0 << 2 | c1 per word, then (c0 << 2 | c1) << 4 | c2 << 2 | c3 per dword
+		__m128i pairs = _mm_maddubs_epi16(codes, _mm_set1_epi16(0x0104));
+		__m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010010));
+
+		return _mm_shuffle_epi8(quads, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+	}
+
+	// the characters of bit pair 0 (high) to 3 (low) of every byte
+	static inline void UnpackCodes(__m128i in, __m128i& c0, __m128i& c1, __m128i& c2, __m128i& c3)
+	{
+		const __m128i charLUT = _mm_setr_epi8('A', 'T', 'G', 'C', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m128i mask = _mm_set1_epi8(3);
+
+		c0 = _mm_shuffle_epi8(charLUT, _mm_and_si128(_mm_srli_epi16(in, 6), mask));
+		c1 = _mm_shuffle_epi8(charLUT, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+		c2 = _mm_shuffle_epi8(charLUT, _mm_and_si128(_mm_srli_epi16(in, 2), mask));
+		c3 = _mm_shuffle_epi8(charLUT, _mm_and_si128(in, mask));
+	}
+#endif
+
+#if defined NUCLEOTIDE_USE_AVX2
+	static inline __m256i EncodeLookup(__m256i in, uint32_t& invalid)
+	{
+		const __m256i charLUT = _mm256_setr_epi8(-1, 'A', 0, 'C', 'T', 0, 0, 'G', 0, 0, 0, 0, 0, 0, 0, 0,
+			-1, 'A', 0, 'C', 'T', 0, 0, 'G', 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i codeLUT = _mm256_setr_epi8(0, 0, 0, 3, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 3, 1, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+
+		__m256i loNibbles = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+		__m256i valid = _mm256_cmpeq_epi8(in, _mm256_shuffle_epi8(charLUT, loNibbles));
+
+		invalid = ~(uint32_t)_mm256_movemask_epi8(valid);
+		return _mm256_and_si256(_mm256_shuffle_epi8(codeLUT, loNibbles), valid);
+	}
+
+	// 32 codes to 8 bytes in the low qword
+	static inline __m128i PackCodes(__m256i codes)
+	{
+		__m256i pairs = _mm256_maddubs_epi16(codes, _mm256_set1_epi16(0x0104));
+		__m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00010010));
+
+		quads = _mm256_shuffle_epi8(quads, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+
+		return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(quads, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1)));
+	}
+
+	static inline void UnpackCodes(__m256i in, __m256i& c0, __m256i& c1, __m256i& c2, __m256i& c3)
+	{
+		const __m256i charLUT = _mm256_setr_epi8('A', 'T', 'G', 'C', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			'A', 'T', 'G', 'C', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i mask = _mm256_set1_epi8(3);
+
+		c0 = _mm256_shuffle_epi8(charLUT, _mm256_and_si256(_mm256_srli_epi16(in, 6), mask));
+		c1 = _mm256_shuffle_epi8(charLUT, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+		c2 = _mm256_shuffle_epi8(charLUT, _mm256_and_si256(_mm256_srli_epi16(in, 2), mask));
+		c3 = _mm256_shuffle_epi8(charLUT, _mm256_and_si256(in, mask));
+	}
+#endif
+}
+
+size_t Nucleotide::packedSize(size_t baseCount)
+{
+	return (baseCount + 3) / 4;
+}
+
+// Packs baseCount characters into packedSize(baseCount) bytes at to, the
+// last byte padded with A, and appends the positions of the N bases.
+size_t Nucleotide::pack(const char* from, size_t baseCount, void* to, std::vector<uint32_t>& NBasePos)
+{
+	const char* it = from;
+	const char* end = from + baseCount;
+	byte* out = (byte*)to;
+
+#if defined NUCLEOTIDE_USE_AVX2
+	while (end - it >= 32)
+	{
+		uint32_t invalid;
+		__m256i codes = EncodeLookup(_mm256_loadu_si256((const __m256i*)it), invalid);
+
+		_mm_storel_epi64((__m128i*)out, PackCodes(codes));
+
+		for (int j = 0; invalid != 0; ++j, invalid >>= 1)
+		{
+			if (invalid & 1) NBasePos.push_back((uint32_t)(it - from + j));
+		}
+
+		it += 32;
+		out += 8;
+	}
+#endif
+#if defined NUCLEOTIDE_USE_SSSE3
+	while (end - it >= 16)
+	{
+		int invalid;
+		__m128i codes = EncodeLookup(_mm_loadu_si128((const __m128i*)it), invalid);
+
+		uint32_t quad = (uint32_t)_mm_cvtsi128_si32(PackCodes(codes));
+		memcpy(out, &quad, 4);
+
+		for (int j = 0; invalid != 0; ++j, invalid >>= 1)
+		{
+			if (invalid & 1) NBasePos.push_back((uint32_t)(it - from + j));
+		}
+
+		it += 16;
+		out += 4;
+	}
+#endif
+
+	while (it != end)
+	{
+		if (end - it >= 4)
+		{
+			byte c0 = codeTable[(byte)it[0]];
+			byte c1 = codeTable[(byte)it[1]];
+			byte c2 = codeTable[(byte)it[2]];
+			byte c3 = codeTable[(byte)it[3]];
+
+			if (((c0 | c1 | c2 | c3) & 4) == 0)
+			{
+				*out++ = c0 << 6 | c1 << 4 | c2 << 2 | c3;
+				it += 4;
+				continue;
+			}
+		}
+
+		// four bases with an N among them, or the last ones
+		byte packed = 0;
+		for (int k = 0; k < 4; ++k)
+		{
+			byte code = it != end ? codeTable[(byte)*it] : 0;
+			if (code == 4)
+			{
+				NBasePos.push_back((uint32_t)(it - from));
+				code = 0;
+			}
+			packed |= code << (6 - 2 * k);
+
+			if (it != end) ++it;
+		}
+		*out++ = packed;
+	}
+
+	return out - (byte*)to;
+}
+
+// Unpacks the first baseCount bases of the packed bytes at from into to.
+void Nucleotide::unpack(const void* from, size_t baseCount, char* to)
+{
+	const byte* in = (const byte*)from;
+	char* out = to;
+	char* end = to + baseCount;
+
+#if defined NUCLEOTIDE_USE_AVX2
+	while (end - out >= 64)
+	{
+		// the low 8 bytes in the low lane, the high 8 in the high lane
+		__m256i bytes = _mm256_permute4x64_epi64(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)in)), 0x50);
+
+		__m256i c0, c1, c2, c3;
+		UnpackCodes(bytes, c0, c1, c2, c3);
+
+		__m256i c01 = _mm256_unpacklo_epi8(c0, c1);
+		__m256i c23 = _mm256_unpacklo_epi8(c2, c3);
+		__m256i lo = _mm256_unpacklo_epi16(c01, c23);
+		__m256i hi = _mm256_unpackhi_epi16(c01, c23);
+
+		_mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+
+		in += 16;
+		out += 64;
+	}
+#endif
+#if defined NUCLEOTIDE_USE_SSSE3
+	while (end - out >= 64)
+	{
+		__m128i c0, c1, c2, c3;
+		UnpackCodes(_mm_loadu_si128((const __m128i*)in), c0, c1, c2, c3);
+
+		__m128i c01 = _mm_unpacklo_epi8(c0, c1);
+		__m128i c23 = _mm_unpacklo_epi8(c2, c3);
+		_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(c01, c23));
+		_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi16(c01, c23));
+
+		c01 = _mm_unpackhi_epi8(c0, c1);
+		c23 = _mm_unpackhi_epi8(c2, c3);
+		_mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi16(c01, c23));
+		_mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi16(c01, c23));
+
+		in += 16;
+		out += 64;
+	}
+#endif
+
+	while (end - out >= 4)
+	{
+		out[0] = baseTable[*in >> 6];
+		out[1] = baseTable[(*in >> 4) & 3];
+		out[2] = baseTable[(*in >> 2) & 3];
+		out[3] = baseTable[*in & 3];
+
+		++in;
+		out += 4;
+	}
+
+	for (int k = 0; out != end; ++k)
+	{
+		*out++ = baseTable[(*in >> (6 - 2 * k)) & 3];
+	}
+}
+
+
+#endif // !NUCLEOTIDE_H
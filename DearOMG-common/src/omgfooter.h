@@ -0,0 +1,123 @@
+#ifndef OMGFOOTER_H
+#define OMGFOOTER_H
+
+//=========================================================================
+// Binary footer of binary-mode OMG files, written by the converters and
+// indexed in place by the parser. All fields are little endian and the
+// tables are 8-byte aligned, so a mapped file needs no parsing.
+//
+//   [zero padding to a multiple of 8]
+//   uint64 offset, uint64 size    x blockCount   <- tableOffset
+//   uint64 first entry            x blockCount   superblock files only
+//   uint8 zstd level              x blockCount   zero padded to a multiple of 8
+//   uint32 CRC32C of the block    x blockCount   zero padded to a multiple of 8, checksum files only
+//   OMGColumn                     x columnCount
+//   uint32 or float value         x entryCount   per column, zero padded to a multiple of 8
+//   OMGFooter                     the last 64 bytes of the file
+//
+// A block is one entry, or one superblock when OMG_FOOTER_SUPERBLOCKS is
+// set. Offsets are absolute. Column k holds the k-th 32-bit word of every
+// entry, from the parameters each binary entry starts with (retention time,
+// msLevel, pixel position, read ids...), so entries can be selected without
+// touching their payload. json and yaml files keep the text footer that
+// ends with the 64-byte offsetLen line.
+//
+// With OMG_FOOTER_CHECKSUMS every block carries the CRC32C of its stored
+// bytes, and OMGFooter.checksum covers everything from headerOffset up to
+// itself: BasicInfo, the tables and the other footer fields.
+//=========================================================================
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#include "crc32c.h"
+
+#define OMG_FOOTER_MAGIC "OMGINDEX"
+#define OMG_FOOTER_VERSION 1
+
+enum OMGFooterFlag
+{
+	OMG_FOOTER_SUPERBLOCKS = 1,
+	OMG_FOOTER_CHECKSUMS = 2
+};
+
+enum OMGColumnType
+{
+	OMG_COLUMN_UINT32 = 0,
+	OMG_COLUMN_FLOAT32 = 1
+};
+
+struct OMGColumn
+{
+	char name[28];
+	uint32_t type;
+};
+
+static_assert(sizeof(OMGColumn) == 32, "OMGColumn must keep the column table 8-byte aligned");
+
+struct OMGFooter
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t entryCount;
+	uint64_t blockCount;
+	uint64_t tableOffset;
+	uint64_t headerOffset;
+	uint64_t headerSize;
+	uint32_t columnCount;
+	uint32_t checksum;
+};
+
+static_assert(sizeof(OMGFooter) == 64, "OMGFooter must fill the 64-byte tail of the file");
+
+// Bytes from tableOffset up to the OMGFooter.
+inline uint64_t OMGFooterTableSize(uint64_t blockCount, uint32_t flags)
+{
+	uint64_t size = blockCount * 2 * sizeof(uint64_t);
+
+	if (flags & OMG_FOOTER_SUPERBLOCKS)
+	{
+		size += blockCount * sizeof(uint64_t);
+	}
+
+	if (flags & OMG_FOOTER_CHECKSUMS)
+	{
+		size += (blockCount * sizeof(uint32_t) + 7) / 8 * 8;
+	}
+
+	return size + (blockCount + 7) / 8 * 8;
+}
+
+// Bytes of the column table, which follows the block table.
+inline uint64_t OMGFooterColumnsSize(uint64_t entryCount, uint32_t columnCount)
+{
+	return columnCount * (sizeof(OMGColumn) + (entryCount * sizeof(uint32_t) + 7) / 8 * 8);
+}
+
+inline OMGColumn MakeOMGColumn(const char* name, uint32_t type)
+{
+	OMGColumn column;
+	memset(column.name, 0, sizeof(column.name));
+	strncpy(column.name, name, sizeof(column.name) - 1);
+	column.type = type;
+
+	return column;
+}
+
+// CRC32C of index, the indexSize bytes from headerOffset up to the footer,
+// followed by the footer fields before checksum.
+inline uint32_t OMGFooterChecksum(const char* index, uint64_t indexSize, const OMGFooter& footer)
+{
+	uint32_t crc = CRC32C::Compute(index, indexSize);
+	return CRC32C::Compute(&footer, offsetof(OMGFooter, checksum), crc);
+}
+
+inline bool IsOMGFooter(const char* tail)
+{
+	return memcmp(tail, OMG_FOOTER_MAGIC, 8) == 0;
+}
+
+
+#endif // !OMGFOOTER_H
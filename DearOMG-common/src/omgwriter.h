@@ -0,0 +1,1276 @@
+#ifndef OMGWRITER_H
+#define OMGWRITER_H
+
+//=========================================================================
+// Writer of OMG files shared by DearOMG-community and DearOMG-vendor: the
+// zstd contexts, levels and dictionaries of the entries, superblocks, the
+// binary footer of omgfooter.h and the text footer of json/yaml files,
+// and --append, which extends a binary file in place. The converters
+// derive from OMGWriter and set its parameters from the command line.
+//=========================================================================
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif // !_WIN32
+
+#ifdef __linux__
+#include <unistd.h>
+#endif // __linux__
+
+#include "zstd.h"
+#include "zdict.h"
+#include "tbb/tbb.h"
+#include "Base64.h"
+#include "omgfooter.h"
+
+class OMGWriter
+{
+public:
+	//=========================================================================
+	// Parameters of the written files
+	//=========================================================================
+	std::string writeMode;
+	std::string outputDir;
+
+	// entries sampled per file to train zstd dictionaries, 0 for none
+	int dictSamples = 0;
+
+	// consecutive entries packed into one zstd frame, by count or by bytes, 0 for none
+	uint32_t superblockEntries = 0;
+	size_t superblockBytes = 0;
+
+	// zstd level, or a range the level is adapted within to the pipeline load
+	int minZstdLevel = 1;
+	int maxZstdLevel = 1;
+	bool longMatching = false;
+
+	// binary .omg file the converted entries are appended to, none for a new file
+	std::string appendFile = "";
+
+protected:
+	// zstd compression context of one worker thread, reused for every block it writes
+	struct ZSTDContext
+	{
+		ZSTD_CCtx* cctx;
+
+		ZSTDContext() : cctx(ZSTD_createCCtx()) {}
+		~ZSTDContext() { ZSTD_freeCCtx(cctx); }
+
+		ZSTDContext(const ZSTDContext&) = delete;
+		ZSTDContext& operator=(const ZSTDContext&) = delete;
+	};
+
+	tbb::enumerable_thread_specific<ZSTDContext> zstdContexts;
+
+	// state of AdaptZSTDLevel over the current interval of entries
+	struct ZSTDLevelControl
+	{
+		int level = 1;
+		bool raised = false;
+		double lastRate = 0.0;
+
+		int entries = 0;
+		size_t queueSum = 0;
+		std::atomic<int64_t> writeMicros{ 0 };
+		std::chrono::steady_clock::time_point start;
+	};
+
+	ZSTDLevelControl levelControl;
+
+	// trained zstd dictionary of one stream type (mz_arr, int_arr, ...), stored in BasicInfo
+	struct ZSTDDictionary
+	{
+		std::string stream;
+		std::vector<char> samples;
+		std::vector<size_t> sampleSizes;
+		std::vector<char> content;
+		std::vector<ZSTD_CDict*> cdicts; // one per zstd level, a CDict fixes the level
+	};
+
+	std::vector<ZSTDDictionary> zstdDicts;
+	std::mutex zstdDictMutex;
+	bool zstdDictSampling = false;
+
+	// entries of the superblock being filled by WriteEntry, and
+	// { offset, size, zstd level, entry count, CRC32C } of every superblock written
+	struct SuperblockBuffer
+	{
+		std::vector<uint32_t> sizes;
+		std::vector<char> data;
+		int level = 1;
+	};
+
+	SuperblockBuffer superblockBuffer;
+	std::vector< std::vector<uint64_t> > superblockTable;
+
+	// footer columns, the k-th one taken from the k-th 32-bit word of every entry
+	std::vector<OMGColumn> metaColumns;
+
+	// footer, tables and BasicInfo of a binary .omg file. appendTarget is
+	// the file --append writes to, as it was before this conversion
+	struct OMGIndex
+	{
+		uint64_t fileSize = 0;
+		OMGFooter footer;
+		std::vector<char> table;
+		std::string basicInfo;
+	};
+
+	OMGIndex appendTarget;
+
+	// the --append file and its size before this conversion, while entries
+	// are being appended to it. RestoreAppendTarget cuts it back on an early exit
+	static std::pair<std::string, uint64_t> pendingAppend;
+
+	// metaColumns holding entry ids, and what WriteEntry adds to them so that
+	// appended entries continue the ids of the --append file
+	std::vector<int> appendIdColumns;
+	uint32_t appendIdShift = 0;
+
+	// the tables of an OMGIndex, laid out as in omgfooter.h
+	struct OMGTables
+	{
+		const uint64_t* blocks; // { offset, size } per block
+		const uint64_t* firstEntries; // superblock files only
+		const char* levels;
+		const uint32_t* checksums;
+		const OMGColumn* columns;
+		const uint32_t* values; // column k starts at values + k * columnStride
+		uint64_t columnStride;
+	};
+
+	void ZSTDEncode(std::vector<char>& input, std::vector<char>& output, const std::string& stream, int level);
+	ZSTD_CCtx* ZSTDContextAt(int level);
+
+	void ResetZSTDLevel();
+	int AdaptZSTDLevel(size_t queueSize, int nThreads);
+	void RecordWriteTime(std::chrono::steady_clock::time_point writeStart);
+
+	template <typename DataT, typename EncodeT>
+	void TrainDictionaries(tbb::concurrent_bounded_queue<DataT>& queue, std::deque<DataT>& sampledData, EncodeT& encodeEntry);
+	void FreeDictionaries();
+	uint32_t NewDictionaryID(std::vector<char>& content, std::vector<uint32_t>& takenIDs);
+	std::map<uint32_t, std::string> InfoDictionaries(std::string& basicInfo);
+	std::string DictionaryInfo();
+
+	bool PackSuperblocks();
+	FILE* OpenPayloadFile(std::string& fileName, uint64_t& startPos, std::string knownInfo);
+	void LoadOMGIndex(std::string& omgFileName, OMGIndex& omgIndex);
+	OMGTables MapOMGTables(OMGIndex& omgIndex);
+	std::string MergeBasicInfo(std::string& oldInfo, std::string& newInfo);
+	std::string CheckAppendTarget(std::string& newInfo);
+	std::vector<int> IdColumns();
+	uint64_t NextEntryId(OMGIndex& omgIndex, std::vector<int>& idColumns);
+	void BeginAppend();
+	static void RestoreAppendTarget();
+	void WriteEntry(FILE* payloadFile, uint64_t& startPos,
+		std::vector< std::vector<uint64_t> >& offsetVectorTmp,
+		uint64_t entryId, int zstdLevel, const char* data, size_t size);
+	void FlushSuperblock(FILE* payloadFile, uint64_t& startPos);
+	void CopyFileBytes(FILE* fromFile, uint64_t fromPos, FILE* toFile, uint64_t byteCount, std::vector<char>& buffer);
+
+	void AppendOMGFooter(std::string& fileName, std::string& baseInfo,
+		std::vector< std::vector<uint64_t> >& offsetVectorTmp, bool packed);
+	void ReWriteOMGFile(std::string& inputFile,
+		std::string& fileName, std::string& baseInfo,
+		std::vector< std::vector<uint64_t> >& offsetVectorTmp);
+};
+
+std::pair<std::string, uint64_t> OMGWriter::pendingAppend("", 0);
+
+void OMGWriter::ZSTDEncode(std::vector<char>& input, std::vector<char>& output, const std::string& stream, int level)
+{
+	// superblocks are compressed as a whole in FlushSuperblock
+	if (PackSuperblocks())
+	{
+		output = input;
+		return;
+	}
+
+	// sampling pass of TrainDictionaries: keep the block, compress nothing
+	if (zstdDictSampling)
+	{
+		std::lock_guard<std::mutex> lock(zstdDictMutex);
+
+		int k = 0;
+		while (k < zstdDicts.size() && zstdDicts[k].stream != stream) ++k;
+
+		if (k == zstdDicts.size())
+		{
+			zstdDicts.push_back(ZSTDDictionary());
+			zstdDicts[k].stream = stream;
+		}
+
+		if (input.size() > 0)
+		{
+			zstdDicts[k].samples.insert(zstdDicts[k].samples.end(), input.begin(), input.end());
+			zstdDicts[k].sampleSizes.push_back(input.size());
+		}
+
+		output.clear();
+		return;
+	}
+
+	ZSTD_CDict* cdict = NULL;
+	for (int i = 0; i < zstdDicts.size(); ++i)
+	{
+		if (zstdDicts[i].stream == stream && !zstdDicts[i].cdicts.empty()) cdict = zstdDicts[i].cdicts[level];
+	}
+
+	int bound = ZSTD_compressBound(input.size());
+	output.resize(bound);
+
+	ZSTD_CCtx* cctx = ZSTDContextAt(level);
+	if (cdict) ZSTD_CCtx_refCDict(cctx, cdict);
+
+	int compSize = ZSTD_compress2(cctx, output.data(), bound, input.data(), input.size());
+	output.resize(compSize);
+}
+
+// The compression context of the calling thread, set to level. Long distance
+// matching is only worth its window at the top of the level range.
+ZSTD_CCtx* OMGWriter::ZSTDContextAt(int level)
+{
+	ZSTD_CCtx* cctx = zstdContexts.local().cctx;
+
+	ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, longMatching && level == maxZstdLevel ? 1 : 0);
+
+	return cctx;
+}
+
+void OMGWriter::ResetZSTDLevel()
+{
+	levelControl.level = minZstdLevel;
+	levelControl.raised = false;
+	levelControl.lastRate = 0.0;
+	levelControl.entries = 0;
+	levelControl.queueSum = 0;
+	levelControl.writeMicros = 0;
+	levelControl.start = std::chrono::steady_clock::now();
+
+	superblockBuffer.level = minZstdLevel;
+}
+
+// Called by the input filter of a pipeline for every entry, returns the level
+// to encode it with. Every 4 * nThreads entries the level moves one step:
+// up while the queue runs dry (encoders wait on the reader) or the writer is
+// busy most of the time (a slow disk), down while entries pile up in the
+// queue. A raise that costs more than a tenth of the entry rate is undone.
+int OMGWriter::AdaptZSTDLevel(size_t queueSize, int nThreads)
+{
+	ZSTDLevelControl& control = levelControl;
+
+	if (minZstdLevel == maxZstdLevel) return minZstdLevel;
+
+	control.queueSum += queueSize;
+	if (++control.entries < 4 * nThreads) return control.level;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double wallMicros = (double)std::chrono::duration_cast<std::chrono::microseconds>(now - control.start).count() + 1.0;
+
+	double rate = control.entries / wallMicros;
+	double occupancy = (double)control.queueSum / control.entries / nThreads;
+	double writeShare = control.writeMicros / wallMicros;
+
+	if (control.raised && rate < 0.9 * control.lastRate)
+	{
+		control.level = std::max(control.level - 1, minZstdLevel);
+		control.raised = false;
+	}
+	else if ((occupancy < 0.25 || writeShare > 0.8) && control.level < maxZstdLevel)
+	{
+		++control.level;
+		control.raised = true;
+	}
+	else if (occupancy > 0.75 && control.level > minZstdLevel)
+	{
+		--control.level;
+		control.raised = false;
+	}
+	else
+	{
+		control.raised = false;
+	}
+
+	control.lastRate = rate;
+	control.entries = 0;
+	control.queueSum = 0;
+	control.writeMicros = 0;
+	control.start = now;
+
+	return control.level;
+}
+
+// Adds the time since writeStart to the writer's share of the interval.
+void OMGWriter::RecordWriteTime(std::chrono::steady_clock::time_point writeStart)
+{
+	levelControl.writeMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - writeStart).count();
+}
+
+// Pops the first dictSamples entries of queue and runs encodeEntry over them
+// while ZSTDEncode collects the blocks of every stream type, then trains one
+// dictionary per type. The popped entries are handed back in sampledData.
+template <typename DataT, typename EncodeT>
+void OMGWriter::TrainDictionaries(tbb::concurrent_bounded_queue<DataT>& queue, std::deque<DataT>& sampledData, EncodeT& encodeEntry)
+{
+	FreeDictionaries();
+
+	if (dictSamples <= 0) return;
+
+	while (sampledData.size() < dictSamples)
+	{
+		DataT data;
+		queue.pop(data);
+		sampledData.push_back(data);
+
+		if (data.stop) break;
+	}
+
+	zstdDictSampling = true;
+	tbb::parallel_for((size_t)0, sampledData.size(),
+		[&](size_t i)
+		{
+			encodeEntry(sampledData[i]);
+		});
+	zstdDictSampling = false;
+
+	// the dictionaries of an --append file keep their IDs
+	std::vector<uint32_t> takenIDs;
+	if (appendFile.length() > 0)
+	{
+		std::map<uint32_t, std::string> appendDicts = InfoDictionaries(appendTarget.basicInfo);
+		for (auto it = appendDicts.begin(); it != appendDicts.end(); ++it)
+		{
+			takenIDs.push_back(it->first);
+		}
+	}
+
+	for (int i = 0; i < zstdDicts.size(); ++i)
+	{
+		ZSTDDictionary& dict = zstdDicts[i];
+
+		// zstd suggests about 100x the dictionary size in samples
+		size_t capacity = std::min((size_t)112640, dict.samples.size() / 10);
+		size_t dictSize = 0;
+
+		if (capacity >= 1024)
+		{
+			dict.content.resize(capacity);
+			dictSize = ZDICT_trainFromBuffer(dict.content.data(), capacity,
+				dict.samples.data(), dict.sampleSizes.data(), (unsigned)dict.sampleSizes.size());
+		}
+
+		if (capacity < 1024 || ZDICT_isError(dictSize))
+		{
+			std::cout << "[WARNING] Cannot train a zstd dictionary for " << dict.stream
+				<< ", it is compressed without one." << std::endl;
+			dict.content.clear();
+		}
+		else
+		{
+			dict.content.resize(dictSize);
+
+			uint32_t dictID = NewDictionaryID(dict.content, takenIDs);
+			for (int j = 0; j < 4; ++j)
+			{
+				dict.content[4 + j] = (char)(dictID >> (8 * j));
+			}
+			takenIDs.push_back(dictID);
+
+			dict.cdicts.assign(maxZstdLevel + 1, NULL);
+			for (int level = minZstdLevel; level <= maxZstdLevel; ++level)
+			{
+				dict.cdicts[level] = ZSTD_createCDict(dict.content.data(), dict.content.size(), level);
+			}
+		}
+
+		std::vector<char>().swap(dict.samples);
+		std::vector<size_t>().swap(dict.sampleSizes);
+	}
+}
+
+void OMGWriter::FreeDictionaries()
+{
+	for (int i = 0; i < zstdDicts.size(); ++i)
+	{
+		for (int j = 0; j < zstdDicts[i].cdicts.size(); ++j)
+		{
+			ZSTD_freeCDict(zstdDicts[i].cdicts[j]);
+		}
+	}
+	zstdDicts.clear();
+}
+
+// The ID of a new dictionary: the CRC32C of its content, ID field cleared,
+// within the range zstd leaves to users, or the next ID not in takenIDs.
+uint32_t OMGWriter::NewDictionaryID(std::vector<char>& content, std::vector<uint32_t>& takenIDs)
+{
+	const uint32_t firstID = 32768;
+	const uint32_t lastID = 0x7FFFFFFF;
+
+	memset(content.data() + 4, 0, 4);
+	uint32_t dictID = firstID + CRC32C::Compute(content.data(), content.size()) % (lastID - firstID + 1);
+
+	while (std::find(takenIDs.begin(), takenIDs.end(), dictID) != takenIDs.end())
+	{
+		dictID = dictID == lastID ? firstID : dictID + 1;
+	}
+
+	return dictID;
+}
+
+// The zstdDict_ lines of a binary BasicInfo, their Base64 content by dictionary ID.
+std::map<uint32_t, std::string> OMGWriter::InfoDictionaries(std::string& basicInfo)
+{
+	std::map<uint32_t, std::string> dicts;
+	std::stringstream stream(basicInfo);
+	std::string line;
+
+	while (std::getline(stream, line))
+	{
+		int colon = line.find(": ");
+		if (line.compare(0, 10, " zstdDict_") != 0 || colon == line.npos) continue;
+
+		std::string dictCode = line.substr(colon + 2);
+		std::vector<char> content(Base64::textToBinarySize(dictCode.length()));
+		content.resize(Base64::textToBinary(dictCode.c_str(), dictCode.length(), content.data()));
+
+		uint32_t dictID = 0;
+		for (int j = 0; j < 4 && 4 + j < content.size(); ++j)
+		{
+			dictID |= (uint32_t)(unsigned char)content[4 + j] << (8 * j);
+		}
+		dicts[dictID] = dictCode;
+	}
+
+	return dicts;
+}
+
+// BasicInfo lines holding the trained dictionaries in Base64, one zstdDict_
+// key per stream type. Every zstd frame names the ID of its dictionary, which
+// is all the parser goes by, so no two dictionaries of a file may share one,
+// also when --append or --merge bring in the dictionaries of another run.
+// IDs are therefore not numbered per run but derived from the content (see
+// NewDictionaryID), which keeps the output reproducible and the IDs of
+// separate runs apart; a clash moves the ID to the next free one.
+std::string OMGWriter::DictionaryInfo()
+{
+	std::string info = "";
+
+	for (int i = 0; i < zstdDicts.size(); ++i)
+	{
+		if (zstdDicts[i].cdicts.empty()) continue;
+
+		std::vector<char> dictCode(Base64::binaryToTextSize(zstdDicts[i].content.size()));
+		Base64::binaryToText(zstdDicts[i].content.data(), zstdDicts[i].content.size(), dictCode.data());
+
+		if (writeMode == "json")
+		{
+			info += "  \"zstdDict_" + zstdDicts[i].stream + "\": \"" + std::string(dictCode.begin(), dictCode.end()) + "\",\n";
+		}
+		else
+		{
+			info += " zstdDict_" + zstdDicts[i].stream + ": " + std::string(dictCode.begin(), dictCode.end()) + "\n";
+		}
+	}
+
+	return info;
+}
+
+bool OMGWriter::PackSuperblocks()
+{
+	return superblockEntries > 0 || superblockBytes > 0;
+}
+
+// Opens the file WriteEntry writes to and sets startPos to where the entries
+// begin. Binary entries go straight into the .omg file, whose header and index
+// are appended once the pipeline is done; json and yaml start with their
+// header, so their entries wait in a .omg.tmp file. --append continues at
+// the end of an existing binary file, once metaColumns and knownInfo, the
+// BasicInfo lines known before the input is read, agree with it.
+FILE* OMGWriter::OpenPayloadFile(std::string& fileName, uint64_t& startPos, std::string knownInfo)
+{
+	std::string payloadFileName = outputDir + fileName + (writeMode == "binary" ? ".omg" : ".omg.tmp");
+	startPos = 0;
+	appendIdShift = 0;
+
+	if (appendFile.length() > 0)
+	{
+		// the footer, tables and BasicInfo already in the file are not overwritten,
+		// the next footer supersedes them
+		LoadOMGIndex(appendFile, appendTarget);
+
+		if (((appendTarget.footer.flags & OMG_FOOTER_SUPERBLOCKS) != 0) != PackSuperblocks())
+		{
+			std::cout << "[ERROR] Use --superblock exactly when " << appendFile << " was written with it!" << std::endl;
+			exit(0);
+		}
+
+		CheckAppendTarget(knownInfo);
+		BeginAppend();
+
+		appendIdColumns = IdColumns();
+		appendIdShift = (uint32_t)NextEntryId(appendTarget, appendIdColumns);
+
+		payloadFileName = appendFile;
+		startPos = appendTarget.fileSize;
+	}
+
+	FILE* payloadFile = fopen(payloadFileName.c_str(), appendFile.length() > 0 ? "ab" : "wb");
+
+	if (!payloadFile)
+	{
+		std::cout << "[ERROR] Cannot create " << payloadFileName << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	return payloadFile;
+}
+
+// Reads the footer, tables and BasicInfo of a binary OMG file, the --append
+// file or one being merged. Only files with checksums are taken, and their
+// index must match its checksum.
+void OMGWriter::LoadOMGIndex(std::string& omgFileName, OMGIndex& omgIndex)
+{
+	FILE* omgFile = fopen(omgFileName.c_str(), "rb");
+
+	if (!omgFile)
+	{
+		std::cout << "[ERROR] Cannot open " << omgFileName << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	struct __stat64 fileStat;
+	_stat64(omgFileName.c_str(), &fileStat);
+	omgIndex.fileSize = fileStat.st_size;
+
+	fpos_t ptrPos;
+	auto readAt = [&](uint64_t pos, uint64_t size, char* buffer)
+	{
+#ifdef _WIN32
+		ptrPos = pos;
+#endif // !_WIN32
+
+#ifdef __linux__
+		ptrPos.__pos = pos;
+#endif // __linux__
+
+		fsetpos(omgFile, &ptrPos);
+		return fread(buffer, sizeof(char), size, omgFile) == size;
+	};
+
+	char tail[sizeof(OMGFooter)];
+	if (omgIndex.fileSize < sizeof(OMGFooter) ||
+		!readAt(omgIndex.fileSize - sizeof(OMGFooter), sizeof(OMGFooter), tail) || !IsOMGFooter(tail))
+	{
+		std::cout << "[ERROR] " << omgFileName << " is not a binary OMG file!" << std::endl;
+		exit(0);
+	}
+
+	OMGFooter& footer = omgIndex.footer;
+	memcpy(&footer, tail, sizeof(OMGFooter));
+
+	if (footer.version > OMG_FOOTER_VERSION || !(footer.flags & OMG_FOOTER_CHECKSUMS))
+	{
+		std::cout << "[ERROR] " << omgFileName << " was written by another version of DearOMG, convert it again!" << std::endl;
+		exit(0);
+	}
+
+	std::vector<char> index(omgIndex.fileSize - sizeof(OMGFooter) - footer.headerOffset);
+
+	if (!readAt(footer.headerOffset, index.size(), index.data()) ||
+		OMGFooterChecksum(index.data(), index.size(), footer) != footer.checksum)
+	{
+		std::cout << "[ERROR] The index of " << omgFileName << " is corrupted!" << std::endl;
+		exit(0);
+	}
+
+	omgIndex.basicInfo.assign(index.begin(), index.begin() + footer.headerSize);
+	omgIndex.table.assign(index.begin() + (footer.tableOffset - footer.headerOffset), index.end());
+
+	fclose(omgFile);
+}
+
+// Points into the tables LoadOMGIndex read.
+OMGWriter::OMGTables OMGWriter::MapOMGTables(OMGIndex& omgIndex)
+{
+	OMGFooter& footer = omgIndex.footer;
+	bool packed = (footer.flags & OMG_FOOTER_SUPERBLOCKS) != 0;
+
+	OMGTables tables;
+	tables.blocks = (const uint64_t*)omgIndex.table.data();
+	tables.firstEntries = tables.blocks + 2 * footer.blockCount;
+	tables.levels = (const char*)(tables.firstEntries + (packed ? footer.blockCount : 0));
+	tables.checksums = (const uint32_t*)(tables.levels + (footer.blockCount + 7) / 8 * 8);
+	tables.columns = (const OMGColumn*)(omgIndex.table.data() + OMGFooterTableSize(footer.blockCount, footer.flags));
+	tables.values = (const uint32_t*)(tables.columns + footer.columnCount);
+	tables.columnStride = (footer.entryCount + 1) / 2 * 2;
+
+	return tables;
+}
+
+// BasicInfo after an append or merge: the old lines with the entry counts
+// summed, then the dictionaries of the new entries and an appendedFile line.
+// The keys the parser needs to decode entries must agree between both.
+std::string OMGWriter::MergeBasicInfo(std::string& oldInfo, std::string& newInfo)
+{
+	auto infoLines = [](std::string& info)
+	{
+		std::vector< std::pair<std::string, std::string> > lines;
+		std::stringstream stream(info);
+		std::string line;
+
+		while (std::getline(stream, line))
+		{
+			int colon = line.find(": ");
+			if (line.length() == 0 || line[0] != ' ' || colon == line.npos) continue;
+
+			lines.push_back(std::make_pair(line.substr(1, colon - 1), line.substr(colon + 2)));
+		}
+
+		return lines;
+	};
+
+	std::vector< std::pair<std::string, std::string> > oldLines = infoLines(oldInfo);
+	std::vector< std::pair<std::string, std::string> > newLines = infoLines(newInfo);
+
+	std::vector<std::string> decodeKeys = { "omics", "writeFormat", "codecTag", "readLength", "pairedEnd", "mateReadLength", "qualityCodec", "mobilityValue", "continuousMzCode" };
+
+	// single-end files leave pairedEnd out, rle quality scores qualityCodec
+	auto hasKey = [](std::vector< std::pair<std::string, std::string> >& lines, std::string key)
+	{
+		for (int i = 0; i < lines.size(); ++i)
+		{
+			if (lines[i].first == key) return true;
+		}
+		return false;
+	};
+
+	std::vector<std::string> optionalKeys = { "pairedEnd", "qualityCodec" };
+	for (int i = 0; i < optionalKeys.size(); ++i)
+	{
+		if (hasKey(oldLines, optionalKeys[i]) != hasKey(newLines, optionalKeys[i]))
+		{
+			std::cout << "[ERROR] The entries cannot be added to " << appendFile << ", its " << optionalKeys[i] << " differs!" << std::endl;
+			exit(0);
+		}
+	}
+
+	// frames name their dictionary by ID only: a dictionary the file already
+	// holds is not added twice, another one under a taken ID cannot be added
+	std::map<uint32_t, std::string> oldDicts = InfoDictionaries(oldInfo);
+	std::map<uint32_t, std::string> newDicts = InfoDictionaries(newInfo);
+
+	for (auto it = newDicts.begin(); it != newDicts.end(); ++it)
+	{
+		if (oldDicts.count(it->first) > 0 && oldDicts[it->first] != it->second)
+		{
+			std::cout << "[ERROR] The entries cannot be added to " << appendFile << ", their zstd dictionary ID "
+				<< it->first << " is already taken by another one!" << std::endl;
+			exit(0);
+		}
+	}
+
+	auto heldDict = [&](std::string& dictCode)
+	{
+		for (auto it = oldDicts.begin(); it != oldDicts.end(); ++it)
+		{
+			if (it->second == dictCode) return true;
+		}
+		return false;
+	};
+
+	std::string merged = "BasicInfo: \n";
+	for (int i = 0; i < oldLines.size(); ++i)
+	{
+		std::string value = oldLines[i].second;
+
+		for (int j = 0; j < newLines.size(); ++j)
+		{
+			if (newLines[j].first != oldLines[i].first) continue;
+
+			if (std::find(decodeKeys.begin(), decodeKeys.end(), oldLines[i].first) != decodeKeys.end() &&
+				newLines[j].second != value)
+			{
+				std::cout << "[ERROR] The entries cannot be added to " << appendFile << ", its " << oldLines[i].first << " differs!" << std::endl;
+				exit(0);
+			}
+			if (oldLines[i].first == "readCount" || oldLines[i].first == "scanCount")
+			{
+				value = std::to_string(std::stoull(value) + std::stoull(newLines[j].second));
+			}
+		}
+
+		merged += " " + oldLines[i].first + ": " + value + "\n";
+	}
+
+	for (int j = 0; j < newLines.size(); ++j)
+	{
+		if (newLines[j].first.compare(0, 9, "zstdDict_") == 0 && !heldDict(newLines[j].second))
+		{
+			merged += " " + newLines[j].first + ": " + newLines[j].second + "\n";
+		}
+		if (newLines[j].first == "parentFile" || newLines[j].first == "appendedFile")
+		{
+			merged += " appendedFile: " + newLines[j].second + "\n";
+		}
+	}
+
+	return merged + "\n";
+}
+
+// Exits before anything is written when the --append file cannot take the new
+// entries: its columns must be metaColumns and the decode keys of newInfo
+// must agree with its BasicInfo. Returns the BasicInfo after the append.
+std::string OMGWriter::CheckAppendTarget(std::string& newInfo)
+{
+	OMGTables tables = MapOMGTables(appendTarget);
+
+	if (appendTarget.footer.columnCount != metaColumns.size() ||
+		memcmp(tables.columns, metaColumns.data(), metaColumns.size() * sizeof(OMGColumn)) != 0)
+	{
+		std::cout << "[ERROR] The entries cannot be added to " << appendFile << ", it holds another kind of entries!" << std::endl;
+		exit(0);
+	}
+
+	return MergeBasicInfo(appendTarget.basicInfo, newInfo);
+}
+
+// metaColumns holding entry ids: scanIndex, spectrumId or readStartId and readEndId.
+std::vector<int> OMGWriter::IdColumns()
+{
+	std::vector<std::string> idNames = { "scanIndex", "spectrumId", "readStartId", "readEndId" };
+	std::vector<int> idColumns;
+
+	for (int k = 0; k < metaColumns.size(); ++k)
+	{
+		if (std::find(idNames.begin(), idNames.end(), std::string(metaColumns[k].name)) != idNames.end())
+		{
+			idColumns.push_back(k);
+		}
+	}
+
+	return idColumns;
+}
+
+// One past the largest id of omgIndex, where the ids of the entries
+// appended or merged into it continue.
+uint64_t OMGWriter::NextEntryId(OMGIndex& omgIndex, std::vector<int>& idColumns)
+{
+	OMGTables tables = MapOMGTables(omgIndex);
+	uint64_t nextId = 0;
+
+	for (int k : idColumns)
+	{
+		for (uint64_t i = 0; i < omgIndex.footer.entryCount; ++i)
+		{
+			nextId = std::max(nextId, (uint64_t)tables.values[k * tables.columnStride + i] + 1);
+		}
+	}
+
+	return nextId;
+}
+
+// Called right before the first byte is appended to the --append file.
+void OMGWriter::BeginAppend()
+{
+	static bool restoreRegistered = atexit(RestoreAppendTarget) == 0;
+
+	pendingAppend = std::make_pair(appendFile, appendTarget.fileSize);
+}
+
+// atexit handler. An [ERROR] exit between BeginAppend and the new footer
+// cuts the --append file back to its old size, so its old footer is the
+// last one again instead of a footerless file.
+void OMGWriter::RestoreAppendTarget()
+{
+	if (pendingAppend.first.length() == 0) return;
+
+	// entries still buffered by stdio would otherwise be flushed behind the cut
+	fflush(NULL);
+
+#ifdef _WIN32
+	int fd = _open(pendingAppend.first.c_str(), _O_RDWR | _O_BINARY);
+	if (fd >= 0)
+	{
+		_chsize_s(fd, pendingAppend.second);
+		_close(fd);
+	}
+#endif // !_WIN32
+
+#ifdef __linux__
+	truncate(pendingAppend.first.c_str(), pendingAppend.second);
+#endif // __linux__
+
+	std::cout << "[INFO] " << pendingAppend.first << " is left as it was before." << std::endl;
+}
+
+// Called by the serial output filter of a pipeline. A superblock is only
+// filled in pipeline order, so the filter runs serial_in_order with --superblock.
+// Every entry adds { entryId, offset or superblock, size, zstd level, CRC32C }
+// and its metaColumns words to offsetVectorTmp. With --append its id words
+// are moved past the ids of the file first.
+void OMGWriter::WriteEntry(FILE* payloadFile, uint64_t& startPos,
+	std::vector< std::vector<uint64_t> >& offsetVectorTmp,
+	uint64_t entryId, int zstdLevel, const char* data, size_t size)
+{
+	bool packed = PackSuperblocks();
+
+	std::vector<char> rebased;
+	if (appendIdShift > 0)
+	{
+		rebased.assign(data, data + size);
+		for (int k : appendIdColumns)
+		{
+			if ((k + 1) * sizeof(uint32_t) > size) continue;
+
+			uint32_t word;
+			memcpy(&word, rebased.data() + k * sizeof(uint32_t), sizeof(uint32_t));
+			word += appendIdShift;
+			memcpy(rebased.data() + k * sizeof(uint32_t), &word, sizeof(uint32_t));
+		}
+		data = rebased.data();
+	}
+
+	std::vector<uint64_t> tmp = { entryId, packed ? superblockTable.size() : startPos, size, (uint64_t)zstdLevel,
+		packed ? 0 : CRC32C::Compute(data, size) };
+	for (int k = 0; k < metaColumns.size() && (k + 1) * sizeof(uint32_t) <= size; ++k)
+	{
+		uint32_t word;
+		memcpy(&word, data + k * sizeof(uint32_t), sizeof(uint32_t));
+		tmp.push_back(word);
+	}
+	offsetVectorTmp.push_back(tmp);
+
+	if (packed)
+	{
+		// a superblock takes the highest level its entries were given
+		superblockBuffer.sizes.push_back((uint32_t)size);
+		superblockBuffer.data.insert(superblockBuffer.data.end(), data, data + size);
+		superblockBuffer.level = std::max(superblockBuffer.level, zstdLevel);
+
+		if (superblockBuffer.sizes.size() == superblockEntries ||
+			(superblockBytes > 0 && superblockBuffer.data.size() >= superblockBytes))
+		{
+			FlushSuperblock(payloadFile, startPos);
+		}
+		return;
+	}
+
+	std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+
+	fwrite(data, 1, size, payloadFile);
+	startPos += size;
+
+	RecordWriteTime(writeStart);
+}
+
+// A superblock is [entry count][entry sizes][entries] in one zstd frame.
+void OMGWriter::FlushSuperblock(FILE* payloadFile, uint64_t& startPos)
+{
+	uint32_t count = superblockBuffer.sizes.size();
+	if (count == 0) return;
+
+	std::vector<char> block((count + 1) * sizeof(uint32_t));
+	memcpy(block.data(), &count, sizeof(uint32_t));
+	memcpy(block.data() + sizeof(uint32_t), superblockBuffer.sizes.data(), count * sizeof(uint32_t));
+	block.insert(block.end(), superblockBuffer.data.begin(), superblockBuffer.data.end());
+
+	std::vector<char> compData(ZSTD_compressBound(block.size()));
+	size_t compSize = ZSTD_compress2(ZSTDContextAt(superblockBuffer.level), compData.data(), compData.size(),
+		block.data(), block.size());
+
+	if (ZSTD_isError(compSize))
+	{
+		std::cout << "[ERROR] Something was wrong in compressing superblock!" << std::endl;
+		exit(0);
+	}
+
+	std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+
+	fwrite(compData.data(), sizeof(char), compSize, payloadFile);
+
+	std::vector<uint64_t> tmp = { startPos, compSize, (uint64_t)superblockBuffer.level, count,
+		CRC32C::Compute(compData.data(), compSize) };
+	superblockTable.push_back(tmp);
+
+	startPos += compSize;
+
+	RecordWriteTime(writeStart);
+
+	superblockBuffer.sizes.clear();
+	superblockBuffer.data.clear();
+	superblockBuffer.level = minZstdLevel;
+}
+
+// Copies byteCount bytes at fromPos of fromFile to where toFile stands. On
+// Linux the kernel copies them with copy_file_range, otherwise (or if the file
+// system refuses) they go through buffer in chunks of up to 64 MB. The footer
+// that follows describes these bytes, so a short read or write stops the
+// converter.
+void OMGWriter::CopyFileBytes(FILE* fromFile, uint64_t fromPos, FILE* toFile, uint64_t byteCount, std::vector<char>& buffer)
+{
+#ifdef __linux__
+	fflush(toFile);
+
+	// both offsets explicit, toFile continues where its stream stands
+	loff_t inPos = fromPos;
+	loff_t outPos = ftello(toFile);
+	while (byteCount > 0)
+	{
+		ssize_t copied = copy_file_range(fileno(fromFile), &inPos, fileno(toFile), &outPos, byteCount, 0);
+		if (copied <= 0) break;
+
+		byteCount -= copied;
+	}
+	fromPos = inPos;
+
+	fseeko(toFile, outPos, SEEK_SET);
+#endif // __linux__
+
+	fpos_t ptrPos;
+
+	while (byteCount > 0)
+	{
+		size_t chunk = std::min(byteCount, (uint64_t)64 << 20);
+		if (buffer.size() < chunk) buffer.resize(chunk);
+
+#ifdef _WIN32
+		ptrPos = fromPos;
+#endif // !_WIN32
+
+#ifdef __linux__
+		ptrPos.__pos = fromPos;
+#endif // __linux__
+
+		fsetpos(fromFile, &ptrPos);
+
+		if (fread(buffer.data(), sizeof(char), chunk, fromFile) != chunk ||
+			fwrite(buffer.data(), sizeof(char), chunk, toFile) != chunk)
+		{
+			std::cout << "[ERROR] Something was wrong in copying " << byteCount << " bytes at offset " << fromPos << "!" << std::endl;
+			exit(0);
+		}
+
+		fromPos += chunk;
+		byteCount -= chunk;
+	}
+}
+
+// Finishes a binary .omg file: the payload is already in place, BasicInfo
+// and the index and columns of omgfooter.h follow it. With --append the
+// tables of the previous footer come first. packed files index the blocks of
+// superblockTable, the others every entry of offsetVectorTmp.
+void OMGWriter::AppendOMGFooter(std::string& fileName, std::string& baseInfo,
+	std::vector< std::vector<uint64_t> >& offsetVectorTmp, bool packed)
+{
+	bool append = appendFile.length() > 0;
+	std::string omgFileName = append ? appendFile : outputDir + fileName + ".omg";
+
+	if (append)
+	{
+		baseInfo = CheckAppendTarget(baseInfo);
+	}
+
+	FILE* omgFile = fopen(omgFileName.c_str(), "ab");
+
+	if (!omgFile)
+	{
+		std::cout << "[ERROR] Cannot create " << omgFileName << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	// { offset, size }, zstd level and CRC32C of every entry, or of every superblock
+	std::vector<uint64_t> blockTable;
+	std::vector<uint64_t> firstEntries;
+	std::vector<char> levels;
+	std::vector<uint32_t> checksums;
+	uint64_t filePos = append ? appendTarget.fileSize : 0;
+	uint64_t entryCount = offsetVectorTmp.size();
+
+	if (packed)
+	{
+		uint64_t packedEntries = 0;
+		for (int i = 0; i < superblockTable.size(); ++i)
+		{
+			blockTable.push_back(superblockTable[i][0]);
+			blockTable.push_back(superblockTable[i][1]);
+			levels.push_back((char)superblockTable[i][2]);
+			checksums.push_back((uint32_t)superblockTable[i][4]);
+
+			firstEntries.push_back(packedEntries);
+			packedEntries += superblockTable[i][3];
+
+			filePos = std::max(filePos, superblockTable[i][0] + superblockTable[i][1]);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < offsetVectorTmp.size(); ++i)
+		{
+			blockTable.push_back(offsetVectorTmp[i][1]);
+			blockTable.push_back(offsetVectorTmp[i][2]);
+			levels.push_back((char)offsetVectorTmp[i][3]);
+			checksums.push_back((uint32_t)offsetVectorTmp[i][4]);
+
+			filePos = std::max(filePos, offsetVectorTmp[i][1] + offsetVectorTmp[i][2]);
+		}
+	}
+
+	// entries already in the file, and their columns
+	uint64_t oldEntries = 0;
+	const char* oldColumns = NULL;
+
+	if (append)
+	{
+		OMGFooter& oldFooter = appendTarget.footer;
+		uint64_t oldBlocks = oldFooter.blockCount;
+
+		const uint64_t* oldTable = (const uint64_t*)appendTarget.table.data();
+		blockTable.insert(blockTable.begin(), oldTable, oldTable + 2 * oldBlocks);
+		oldTable += 2 * oldBlocks;
+
+		if (packed)
+		{
+			for (int i = 0; i < firstEntries.size(); ++i)
+			{
+				firstEntries[i] += oldFooter.entryCount;
+			}
+			firstEntries.insert(firstEntries.begin(), oldTable, oldTable + oldBlocks);
+			oldTable += oldBlocks;
+		}
+
+		const char* oldLevels = (const char*)oldTable;
+		levels.insert(levels.begin(), oldLevels, oldLevels + oldBlocks);
+
+		const uint32_t* oldChecksums = (const uint32_t*)(oldLevels + (oldBlocks + 7) / 8 * 8);
+		checksums.insert(checksums.begin(), oldChecksums, oldChecksums + oldBlocks);
+
+		oldEntries = oldFooter.entryCount;
+		oldColumns = appendTarget.table.data() + OMGFooterTableSize(oldBlocks, oldFooter.flags) +
+			oldFooter.columnCount * sizeof(OMGColumn);
+
+		entryCount += oldEntries;
+	}
+
+	OMGFooter footer;
+	memcpy(footer.magic, OMG_FOOTER_MAGIC, 8);
+	footer.version = OMG_FOOTER_VERSION;
+	footer.flags = OMG_FOOTER_CHECKSUMS | (packed ? OMG_FOOTER_SUPERBLOCKS : 0);
+	footer.entryCount = entryCount;
+	footer.blockCount = levels.size();
+	footer.headerOffset = filePos;
+	footer.headerSize = baseInfo.length();
+	footer.tableOffset = (filePos + baseInfo.length() + 7) / 8 * 8;
+	footer.columnCount = metaColumns.size();
+
+	std::vector<char> table(footer.tableOffset - filePos - baseInfo.length() +
+		OMGFooterTableSize(footer.blockCount, footer.flags) +
+		OMGFooterColumnsSize(footer.entryCount, footer.columnCount), 0);
+	char* tablePtr = table.data() + (footer.tableOffset - filePos - baseInfo.length());
+
+	memcpy(tablePtr, blockTable.data(), blockTable.size() * sizeof(uint64_t));
+	tablePtr += blockTable.size() * sizeof(uint64_t);
+
+	if (packed)
+	{
+		memcpy(tablePtr, firstEntries.data(), firstEntries.size() * sizeof(uint64_t));
+		tablePtr += firstEntries.size() * sizeof(uint64_t);
+	}
+
+	memcpy(tablePtr, levels.data(), levels.size());
+	tablePtr += (levels.size() + 7) / 8 * 8;
+
+	memcpy(tablePtr, checksums.data(), checksums.size() * sizeof(uint32_t));
+	tablePtr += (checksums.size() * sizeof(uint32_t) + 7) / 8 * 8;
+
+	memcpy(tablePtr, metaColumns.data(), metaColumns.size() * sizeof(OMGColumn));
+	tablePtr += metaColumns.size() * sizeof(OMGColumn);
+
+	for (int k = 0; k < metaColumns.size(); ++k)
+	{
+		uint32_t* column = (uint32_t*)tablePtr;
+		if (oldEntries > 0)
+		{
+			memcpy(column, oldColumns + k * ((oldEntries * sizeof(uint32_t) + 7) / 8 * 8), oldEntries * sizeof(uint32_t));
+		}
+
+		for (int i = 0; i < offsetVectorTmp.size(); ++i)
+		{
+			column[oldEntries + i] = k + 5 < offsetVectorTmp[i].size() ? (uint32_t)offsetVectorTmp[i][k + 5] : 0;
+		}
+		tablePtr += (entryCount * sizeof(uint32_t) + 7) / 8 * 8;
+	}
+
+	std::string index = baseInfo;
+	index.append(table.begin(), table.end());
+	footer.checksum = OMGFooterChecksum(index.data(), index.length(), footer);
+
+	fwrite(index.data(), sizeof(char), index.length(), omgFile);
+	fwrite((char*)&footer, sizeof(char), sizeof(OMGFooter), omgFile);
+
+	fclose(omgFile);
+
+	superblockTable.clear();
+	pendingAppend.first = "";
+}
+
+void OMGWriter::ReWriteOMGFile(std::string& inputFile,
+	std::string& fileName, std::string& baseInfo,
+	std::vector< std::vector<uint64_t> >& offsetVectorTmp)
+{
+	if (writeMode == "binary")
+	{
+		AppendOMGFooter(fileName, baseInfo, offsetVectorTmp, PackSuperblocks());
+		return;
+	}
+
+	std::string tmpFileName = outputDir + fileName + ".omg.tmp";
+
+	FILE* tmpFile = fopen(tmpFileName.c_str(), "rb");
+
+	if (!tmpFile)
+	{
+		std::cout << "[ERROR] Cannot create " << tmpFileName << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	std::string omgFileName = outputDir + fileName + ".omg";
+
+	FILE* omgFile = fopen(omgFileName.c_str(), "wb");
+
+	if (!omgFile)
+	{
+		std::cout << "[ERROR] Cannot create " << omgFileName << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	fwrite(baseInfo.c_str(), 1, baseInfo.length(), omgFile);
+
+	std::vector<uint32_t> offsetVector;
+	offsetVector.push_back((uint32_t)baseInfo.length());
+
+	// zstd level of every entry
+	std::vector<uint32_t> levelVector;
+
+	// entries that follow each other in the .omg.tmp file are copied as one run
+	std::vector<char> copyBuffer;
+	uint64_t runPos = 0;
+	uint64_t runSize = 0;
+
+	for (int i = 0; i < offsetVectorTmp.size(); ++i)
+	{
+		offsetVector.push_back((uint32_t)offsetVectorTmp[i][2]);
+		levelVector.push_back((uint32_t)offsetVectorTmp[i][3]);
+
+		if (runPos + runSize != offsetVectorTmp[i][1])
+		{
+			CopyFileBytes(tmpFile, runPos, omgFile, runSize, copyBuffer);
+
+			runPos = offsetVectorTmp[i][1];
+			runSize = 0;
+		}
+		runSize += offsetVectorTmp[i][2];
+	}
+
+	CopyFileBytes(tmpFile, runPos, omgFile, runSize, copyBuffer);
+
+	auto arrayToText = [](std::vector<uint32_t>& array)
+	{
+		std::vector<char> arrayCharVec(array.size() * sizeof(uint32_t));
+		if (array.size() > 0)
+		{
+			memcpy(arrayCharVec.data(), array.data(), arrayCharVec.size());
+		}
+
+		char* arrayCode = (char*)malloc(2 * arrayCharVec.size());
+		size_t writeLen = Base64::binaryToText(arrayCharVec.data(), arrayCharVec.size(), arrayCode);
+
+		std::string arrayString(arrayCode, arrayCode + writeLen);
+		free(arrayCode);
+
+		return arrayString;
+	};
+
+	std::string offsetString = arrayToText(offsetVector);
+	std::string writeOffset = "";
+
+	if (writeMode == "json")
+	{
+		writeOffset = " \"offsetArr\": \"" + offsetString + "\"\n";
+		writeOffset += " \"levelArr\": \"" + arrayToText(levelVector) + "\"\n";
+
+		std::string writeOffsetLen = " \"offsetLen\":";
+		std::string len = std::to_string(writeOffset.length());
+
+		writeOffsetLen += len;
+
+		int res = 64 - writeOffsetLen.length() - 2;
+		for (int i = 0; i < res; ++i)
+		{
+			writeOffsetLen += ' ';
+		}
+		writeOffsetLen += "\n}";
+
+		writeOffset += writeOffsetLen;
+	}
+	if (writeMode == "yaml")
+	{
+		writeOffset = "offsetArr: " + offsetString + "\n";
+		writeOffset += "levelArr: " + arrayToText(levelVector) + "\n";
+
+		std::string writeOffsetLen = "offsetLen:";
+		std::string len = std::to_string(writeOffset.length());
+
+		writeOffsetLen += len;
+
+		int res = 64 - writeOffsetLen.length() - 1;
+		for (int i = 0; i < res; ++i)
+		{
+			writeOffsetLen += ' ';
+		}
+		writeOffsetLen += "\n";
+
+		writeOffset += writeOffsetLen;
+	}
+
+	fwrite(writeOffset.data(), sizeof(char), writeOffset.length(), omgFile);
+
+	fclose(tmpFile);
+	fclose(omgFile);
+
+	if (remove(tmpFileName.c_str()) == 0)
+	{
+		std::cout << "[INFO] Delete .tmp file success!" << std::endl;
+	}
+	else
+	{
+		std::cout << "[WARNING] Cannot delete .tmp file!" << std::endl;
+	}
+}
+
+
+#endif // !OMGWRITER_H
@@ -0,0 +1,394 @@
+#ifndef QUALITYCODEC_H
+#define QUALITYCODEC_H
+
+//=========================================================================
+// Context-model quality score codec of the genomics "qValue" stream,
+// shared by DearOMG-community and DearOMG-parser (--quality_codec=fqz).
+//
+// The characters of the alphabet (qKey) are coded as their index, in one
+// nibble when the alphabet holds up to 16 characters and in two, high
+// nibble first, otherwise. Every nibble has an adaptive 16-symbol model
+// in its context, in the manner of fqzcomp: the previous score, the
+// higher of the two before it, the position in the read and how often the
+// score changed so far in the read. Small alphabets (binned scores) keep
+// more bits of the latter than large ones, so that a batch of reads still
+// fills its contexts.
+//
+// A model is a 15-bit cumulative frequency table moved towards the coded
+// symbol after every use, with every symbol keeping a frequency of at
+// least 1. SSE2 updates and searches the 16 entries at once.
+//
+// The models drive four interleaved rANS states (32-bit, byte-wise
+// renormalization). The models adapt, so the encoder runs them forward
+// first and codes the symbols backwards.
+//
+// Stream: [score count (4)][4 rANS states (4 each)][rANS bytes], little
+// endian. An alphabet of one character needs no stream.
+//=========================================================================
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined __SSE2__
+#include <emmintrin.h>
+#define QUALITYCODEC_USE_SSE2
+#endif
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+class QualityCodec
+{
+public:
+	// Codes the n scores of quality, reads of readLength scores, into out.
+	// alphabet receives the characters used, in ascending order.
+	static void Encode(const char* quality, size_t n, uint32_t readLength,
+		std::string& alphabet, std::vector<char>& out)
+	{
+		bool used[256] = { false };
+		for (size_t i = 0; i < n; ++i)
+		{
+			used[(unsigned char)quality[i]] = true;
+		}
+
+		unsigned char symbols[256];
+		alphabet = "";
+		for (int c = 0; c < 256; ++c)
+		{
+			if (!used[c]) continue;
+
+			symbols[c] = (unsigned char)alphabet.size();
+			alphabet += (char)c;
+		}
+
+		out.clear();
+		if (alphabet.size() < 2) return;
+
+		Context context(alphabet.size(), readLength);
+
+		// every coded nibble as its { cumulative frequency, frequency }
+		std::vector<uint32_t> steps;
+		steps.reserve(n * (context.wide ? 2 : 1));
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			uint32_t symbol = symbols[(unsigned char)quality[i]];
+			Model* models = context.Models();
+
+			if (context.wide)
+			{
+				steps.push_back(models[0].Encode(symbol >> 4));
+				steps.push_back(models[1 + (symbol >> 4)].Encode(symbol & 15));
+			}
+			else
+			{
+				steps.push_back(models[0].Encode(symbol));
+			}
+
+			context.Next(symbol);
+		}
+
+		// a step takes at most 15 bits, the frequencies being at least 1
+		std::vector<unsigned char> buffer(steps.size() * 2 + 32);
+		unsigned char* ptr = buffer.data() + buffer.size();
+
+		uint32_t states[4] = { RANS_L, RANS_L, RANS_L, RANS_L };
+
+		for (size_t i = steps.size(); i-- > 0;)
+		{
+			uint32_t& x = states[i & 3];
+
+			uint32_t start = steps[i] & 0xFFFF;
+			uint32_t freq = steps[i] >> 16;
+
+			uint32_t xMax = ((RANS_L >> PROB_BITS) << 8) * freq;
+			while (x >= xMax)
+			{
+				*--ptr = (unsigned char)x;
+				x >>= 8;
+			}
+
+			x = ((x / freq) << PROB_BITS) + (x % freq) + start;
+		}
+
+		for (int j = 3; j >= 0; --j)
+		{
+			ptr -= 4;
+			for (int b = 0; b < 4; ++b)
+			{
+				ptr[b] = (unsigned char)(states[j] >> (8 * b));
+			}
+		}
+
+		for (int b = 0; b < 4; ++b)
+		{
+			out.push_back((char)(n >> (8 * b)));
+		}
+		out.insert(out.end(), (const char*)ptr, (const char*)buffer.data() + buffer.size());
+	}
+
+	// Decodes a stream of Encode into quality; false if it is corrupted or
+	// holds more than maxCount scores.
+	static bool Decode(const unsigned char* data, size_t size, const std::string& alphabet,
+		uint32_t readLength, size_t maxCount, std::string& quality)
+	{
+		if (alphabet.size() < 2 || size < 20) return false;
+
+		const unsigned char* end = data + size;
+
+		uint32_t n = 0;
+		uint32_t states[4];
+		for (int b = 0; b < 4; ++b)
+		{
+			n |= (uint32_t)data[b] << (8 * b);
+		}
+		for (int j = 0; j < 4; ++j)
+		{
+			states[j] = 0;
+			for (int b = 0; b < 4; ++b)
+			{
+				states[j] |= (uint32_t)data[4 + 4 * j + b] << (8 * b);
+			}
+		}
+		data += 20;
+
+		if (n > maxCount) return false;
+
+		Context context(alphabet.size(), readLength);
+
+		quality.resize(n);
+		size_t step = 0;
+
+		// one nibble with the next state
+		auto decodeNibble = [&](Model& model, uint32_t& nibble)
+		{
+			uint32_t& x = states[step++ & 3];
+
+			uint32_t slot = x & (PROB_SCALE - 1);
+			uint32_t start, freq;
+			nibble = model.Decode(slot, start, freq);
+
+			x = freq * (x >> PROB_BITS) + slot - start;
+
+			while (x < RANS_L)
+			{
+				if (data == end) return false;
+				x = (x << 8) | *data++;
+			}
+
+			return true;
+		};
+
+		for (uint32_t i = 0; i < n; ++i)
+		{
+			Model* models = context.Models();
+
+			uint32_t symbol = 0;
+			if (context.wide)
+			{
+				uint32_t hi, lo;
+				if (!decodeNibble(models[0], hi) || hi >= context.modelsPerContext - 1 ||
+					!decodeNibble(models[1 + hi], lo))
+				{
+					return false;
+				}
+
+				symbol = hi << 4 | lo;
+			}
+			else if (!decodeNibble(models[0], symbol))
+			{
+				return false;
+			}
+
+			if (symbol >= alphabet.size()) return false;
+
+			quality[i] = alphabet[symbol];
+			context.Next(symbol);
+		}
+
+		return true;
+	}
+
+private:
+	static const uint32_t PROB_BITS = 15;
+	static const uint32_t PROB_SCALE = 1u << PROB_BITS;
+	static const uint32_t RANS_L = 1u << 23;
+
+	static inline uint32_t PopCount(uint32_t word)
+	{
+#if defined _MSC_VER
+		return __popcnt(word);
+#else
+		return __builtin_popcount(word);
+#endif
+	}
+
+	// adaptive frequencies of 16 symbols
+	struct Model
+	{
+		// cdf[s] is the cumulative frequency below symbol s, cdf[16] being PROB_SCALE
+		uint16_t cdf[16];
+		uint16_t count;
+
+		void Reset()
+		{
+			for (int s = 0; s < 16; ++s)
+			{
+				cdf[s] = (uint16_t)(s * (PROB_SCALE / 16));
+			}
+			count = 0;
+		}
+
+		// the { cumulative frequency, frequency } of symbol, then the update
+		uint32_t Encode(uint32_t symbol)
+		{
+			uint32_t start = cdf[symbol];
+			uint32_t freq = (symbol == 15 ? PROB_SCALE : cdf[symbol + 1]) - start;
+
+			Update(symbol);
+			return start | freq << 16;
+		}
+
+		// the symbol of slot, and its cumulative frequency and frequency
+		uint32_t Decode(uint32_t slot, uint32_t& start, uint32_t& freq)
+		{
+			uint32_t symbol = 0;
+#if defined QUALITYCODEC_USE_SSE2
+			__m128i slots = _mm_set1_epi16((short)slot);
+			__m128i above0 = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)cdf), slots);
+			__m128i above1 = _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(cdf + 8)), slots);
+
+			// the entries not above slot, cdf[0] = 0 being one of them
+			uint32_t above = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(above0, above1));
+			symbol = 15 - PopCount(above);
+#else
+			while (symbol < 15 && cdf[symbol + 1] <= slot) ++symbol;
+#endif
+			start = cdf[symbol];
+			freq = (symbol == 15 ? PROB_SCALE : cdf[symbol + 1]) - start;
+
+			Update(symbol);
+			return symbol;
+		}
+
+		// Moves the table towards symbol taking all but 15 of PROB_SCALE,
+		// faster while the model is new. No frequency drops below 1.
+		void Update(uint32_t symbol)
+		{
+			uint32_t rate = count < 2 ? 2 : count < 8 ? 3 : count < 32 ? 4 : 5;
+			if (count < 32) ++count;
+
+#if defined QUALITYCODEC_USE_SSE2
+			const __m128i index0 = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+			const __m128i index1 = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+			__m128i symbols = _mm_set1_epi16((short)symbol);
+			__m128i lift = _mm_set1_epi16((short)(PROB_SCALE - 16));
+			__m128i shift = _mm_cvtsi32_si128((int)rate);
+
+			__m128i target0 = _mm_add_epi16(index0, _mm_and_si128(_mm_cmpgt_epi16(index0, symbols), lift));
+			__m128i target1 = _mm_add_epi16(index1, _mm_and_si128(_mm_cmpgt_epi16(index1, symbols), lift));
+
+			__m128i cdf0 = _mm_loadu_si128((const __m128i*)cdf);
+			__m128i cdf1 = _mm_loadu_si128((const __m128i*)(cdf + 8));
+
+			cdf0 = _mm_add_epi16(cdf0, _mm_sra_epi16(_mm_sub_epi16(target0, cdf0), shift));
+			cdf1 = _mm_add_epi16(cdf1, _mm_sra_epi16(_mm_sub_epi16(target1, cdf1), shift));
+
+			_mm_storeu_si128((__m128i*)cdf, cdf0);
+			_mm_storeu_si128((__m128i*)(cdf + 8), cdf1);
+#else
+			for (uint32_t s = 1; s < 16; ++s)
+			{
+				int32_t target = s > symbol ? (int32_t)(PROB_SCALE - 16 + s) : (int32_t)s;
+				cdf[s] = (uint16_t)(cdf[s] + ((target - (int32_t)cdf[s]) >> rate));
+			}
+#endif
+		}
+	};
+
+	// the read so far and the models of every context
+	struct Context
+	{
+		// two nibbles per score: a high nibble model and a low nibble model per high nibble
+		bool wide;
+		uint32_t modelsPerContext;
+
+		uint32_t symbolBits = 1;
+		uint32_t q2Bits = 0;
+		uint32_t posBits = 0;
+		uint32_t deltaBits = 0;
+
+		uint32_t readLength;
+		std::vector<uint8_t> posBuckets;
+
+		std::vector<Model> models;
+
+		uint32_t pos = 0;
+		uint32_t q1 = 0;
+		uint32_t q2 = 0;
+		uint32_t q3 = 0;
+		uint32_t delta = 0;
+
+		Context(size_t alphabetSize, uint32_t readLength) : readLength(readLength > 0 ? readLength : 1)
+		{
+			while ((1u << symbolBits) < alphabetSize) ++symbolBits;
+
+			wide = alphabetSize > 16;
+			modelsPerContext = wide ? 1 + (uint32_t)((alphabetSize + 15) >> 4) : 1;
+
+			// the context bits besides q1
+			uint32_t extraBits = symbolBits <= 2 ? 6 : symbolBits <= 4 ? 4 : 2;
+			q2Bits = std::min(symbolBits, 2u);
+			posBits = extraBits >= 4 ? 2 : 0;
+			deltaBits = std::min(2u, extraBits - q2Bits - posBits);
+
+			Model model;
+			model.Reset();
+			models.assign((size_t)modelsPerContext << (symbolBits + q2Bits + posBits + deltaBits), model);
+
+			posBuckets.resize(this->readLength);
+			for (uint32_t i = 0; i < this->readLength; ++i)
+			{
+				posBuckets[i] = (uint8_t)(((uint64_t)i << posBits) / this->readLength);
+			}
+		}
+
+		// the models of the next score
+		Model* Models()
+		{
+			uint32_t ctx = q1;
+
+			uint32_t q23 = std::max(q2, q3);
+			ctx = ctx << q2Bits | (q23 >> (symbolBits - q2Bits));
+
+			ctx = ctx << posBits | posBuckets[pos];
+
+			uint32_t deltaBucket = delta == 0 ? 0 : delta < 4 ? 1 : delta < 16 ? 2 : 3;
+			ctx = ctx << deltaBits | (deltaBucket >> (2 - deltaBits));
+
+			return models.data() + (size_t)ctx * modelsPerContext;
+		}
+
+		void Next(uint32_t symbol)
+		{
+			if (pos > 0 && symbol != q1) ++delta;
+
+			q3 = q2;
+			q2 = q1;
+			q1 = symbol;
+
+			if (++pos == readLength)
+			{
+				pos = 0;
+				q1 = q2 = q3 = 0;
+				delta = 0;
+			}
+		}
+	};
+};
+
+
+#endif // !QUALITYCODEC_H
@@ -6,129 +6,205 @@
 #include <iostream>
 
 #include "namespace.h"
-
-void DearOMG::LoadFastqFile(std::string inputFile)
+#include "Gzip.h"
+
+// Reads the FASTQ file in chunks of fastqBufferSize bytes and finds its lines
+// with memchr. A batch of fastqBatchSize reads points into the chunk it was
+// read in, which it shares with the other batches of that chunk, so no line
+// is copied. The lines of the batch a chunk ends in are carried over to the
+// front of the next chunk. .fastq.gz files are decompressed on the fly.
+// With a mateFile, the R2 file of a pair, both files are read in lockstep
+// and a batch holds the same reads of both.
+void DearOMG::LoadFastqFile(std::string inputFile, std::string mateFile)
 {
 	struct __stat64 fileStat;
 
 	_stat64(inputFile.c_str(), &fileStat);
 	int64_t fileVolume = fileStat.st_size; // Bytes
 
-	FILE* fastqFile = fopen(inputFile.c_str(), "r");
-
-	if (fastqFile == NULL)
+	struct FastqStream
 	{
-		std::cout << "Cannot open " << inputFile << "\n"
-			<< "Please check your file or directory!" << std::endl;
-		exit(0);
-	}
+		FILE* file = NULL;
+		std::unique_ptr<GzipReader> gzipReader;
 
-	char* buffer = (char*)malloc((fastqBufferSize + 1) * sizeof(char));
-	buffer[fastqBufferSize] = 0;
+		std::shared_ptr<char> chunk;
+		size_t len = 0;
+		size_t lineStart = 0;
+		bool lastChunk = false;
+	};
 
-	int lineCount = 0;
-	std::string contents = "";
-	int nLines = fastqBatchSize * 4;
+	auto openStream = [&](std::string& fileName, FastqStream& stream)
+	{
+		stream.file = fopen(fileName.c_str(), "rb");
 
-	uint32_t index = 0;
-	uint32_t readStartId = 0;
-	uint32_t estReadCount = 0;
-	std::vector<std::string> readsData;
+		if (stream.file == NULL)
+		{
+			std::cout << "Cannot open " << fileName << "\n"
+				<< "Please check your file or directory!" << std::endl;
+			exit(0);
+		}
 
-	uint32_t checkPoint = 0;
+		if (GetInputFileNameAndSuffix(fileName)[1] == "fastq.gz")
+		{
+			stream.gzipReader.reset(new GzipReader(stream.file));
+		}
+	};
+
+	int nLines = fastqBatchSize * 4;
 
-	while (true)
+	// Fills lines with the next nLines lines of stream, fewer only at its end.
+	auto nextBatch = [&](FastqStream& stream, FastqLines& lines)
 	{
-		if (feof(fastqFile)) break;
+		size_t batchStart = stream.lineStart;
 
-		size_t len = fread(buffer, 1, fastqBufferSize, fastqFile);
+		lines.lineStarts.clear();
+		lines.lineLengths.clear();
 
-		for (int i = 0; i < len; ++i)
+		while (lines.lineStarts.size() < nLines)
 		{
-			if (buffer[i] == '\r') continue;
+			const char* data = stream.chunk.get();
+			const char* newline = stream.lineStart < stream.len ?
+				(const char*)memchr(data + stream.lineStart, '\n', stream.len - stream.lineStart) : NULL;
 
-			if (buffer[i] != '\n')
+			if (newline == NULL && !stream.lastChunk)
 			{
-				contents += buffer[i];
-			}
-			else
-			{
-				++lineCount;
-
-				readsData.push_back(contents);
+				// the lines of the unfinished batch are read again from the next chunk
+				size_t carryLen = stream.len - batchStart;
 
-				if ((lineCount & 3) == 0)
+				std::shared_ptr<char> chunk(new char[carryLen + fastqBufferSize], std::default_delete<char[]>());
+				if (carryLen > 0)
 				{
-					++index;
+					memcpy(chunk.get(), data + batchStart, carryLen);
 				}
 
-				if (lineCount == nLines)
-				{
-					if (readStartId == 0)
-					{
-						genoHeader.readLength = std::to_string(readsData[1].length());
-						estReadCount = fileVolume / (3 * readsData[1].length());
-
-						checkPoint = (uint32_t)(0.01 * estReadCount);
-					}
-
-					GenoData genoData;
-					
-					genoData.readsData = readsData;
-
-					genoData.readEndId = index - 1;
-					genoData.readStartId = readStartId;
-
-					genoQueue.push(genoData);
-
-					readStartId = index;
-
-					lineCount = 0;
-					readsData.clear();
-
-					if (readStartId == 0)
-					{
-						std::cout << "Process: ";
-					}
-					if (index % checkPoint == 0)
-					{
-						if (index < estReadCount)
-						{
-							std::cout << index / checkPoint << "..." << std::flush;
-						}
-					}
-				}
+				stream.len = carryLen + (stream.gzipReader ? stream.gzipReader->Read(chunk.get() + carryLen, fastqBufferSize) :
+					fread(chunk.get() + carryLen, 1, fastqBufferSize, stream.file));
+				stream.lastChunk = stream.len < carryLen + fastqBufferSize;
+				stream.chunk = chunk;
+				stream.lineStart = 0;
+				batchStart = 0;
 
-				contents = "";
+				lines.lineStarts.clear();
+				lines.lineLengths.clear();
+				continue;
 			}
+			if (stream.lineStart == stream.len) break;
+
+			size_t lineEnd = newline == NULL ? stream.len : newline - data;
+			size_t lineLen = lineEnd - stream.lineStart;
+			if (lineLen > 0 && data[lineEnd - 1] == '\r') --lineLen;
+
+			lines.lineStarts.push_back((uint32_t)stream.lineStart);
+			lines.lineLengths.push_back((uint32_t)lineLen);
+
+			stream.lineStart = std::min(lineEnd + 1, stream.len);
 		}
-	}
 
-	if (readsData.size() > 0)
+		lines.chunk = stream.chunk;
+
+		return lines.lineStarts.size() > 0;
+	};
+
+	// the length of the read name of line i, up to the space or the /1 and /2 of the mate
+	auto readNameLength = [](FastqLines& lines, size_t i)
+	{
+		const char* line = lines.chunk.get() + lines.lineStarts[i];
+		uint32_t len = 0;
+
+		while (len < lines.lineLengths[i] && line[len] != ' ' && line[len] != '/') ++len;
+
+		return len;
+	};
+
+	// whether every record of the batch has the same read name as its mate
+	auto sameReadNames = [&](FastqLines& reads, FastqLines& mateReads)
+	{
+		for (size_t i = 0; i < reads.lineStarts.size(); i += 4)
+		{
+			uint32_t len = readNameLength(reads, i);
+
+			if (len != readNameLength(mateReads, i) ||
+				memcmp(reads.chunk.get() + reads.lineStarts[i], mateReads.chunk.get() + mateReads.lineStarts[i], len) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	FastqStream fastqStream;
+	FastqStream mateStream;
+
+	bool paired = mateFile.length() > 0;
+
+	openStream(inputFile, fastqStream);
+	if (paired) openStream(mateFile, mateStream);
+
+	uint32_t index = 0;
+	uint32_t readStartId = 0;
+	uint32_t estReadCount = 0;
+
+	uint32_t checkPoint = 0;
+
+	GenoData genoData;
+
+	while (nextBatch(fastqStream, genoData.reads))
 	{
-		GenoData genoData;
+		if (paired && (!nextBatch(mateStream, genoData.mateReads) ||
+			genoData.mateReads.lineStarts.size() != genoData.reads.lineStarts.size() ||
+			!sameReadNames(genoData.reads, genoData.mateReads)))
+		{
+			std::cout << "[ERROR] " << inputFile << " and " << mateFile << " are not mates, their reads differ!" << std::endl;
+			exit(0);
+		}
+
+		if (readStartId == 0 && genoData.reads.lineStarts.size() > 1)
+		{
+			genoHeader.readLength = std::to_string(genoData.reads.lineLengths[1]);
+			if (paired) genoHeader.mateReadLength = std::to_string(genoData.mateReads.lineLengths[1]);
+
+			GzipReader* gzipReader = fastqStream.gzipReader.get();
+			int64_t volume = gzipReader ? (int64_t)(fileVolume * gzipReader->Ratio()) : fileVolume;
+			estReadCount = volume / (3 * std::max(genoData.reads.lineLengths[1], (uint32_t)1));
+
+			checkPoint = (uint32_t)(0.01 * estReadCount);
+
+			std::cout << "Process: ";
+		}
 
-		genoData.readsData = readsData;
+		index += genoData.reads.lineStarts.size() / 4;
 
 		genoData.readEndId = index - 1;
 		genoData.readStartId = readStartId;
 
 		genoQueue.push(genoData);
 
-		readsData.clear();
+		readStartId = index;
+
+		if (checkPoint > 0 && index % checkPoint == 0 && index < estReadCount)
+		{
+			std::cout << index / checkPoint << "..." << std::flush;
+		}
+	}
+
+	if (paired && nextBatch(mateStream, genoData.mateReads))
+	{
+		std::cout << "[ERROR] " << inputFile << " and " << mateFile << " are not mates, their reads differ!" << std::endl;
+		exit(0);
 	}
 
 	genoHeader.readCount = std::to_string(index);
 
-	GenoData genoData;
-	genoData.stop = true;
-	genoQueue.push(genoData);
+	GenoData stopData;
+	stopData.stop = true;
+	genoQueue.push(stopData);
 
-	free(buffer);
-	fclose(fastqFile);
+	fclose(fastqStream.file);
+	if (paired) fclose(mateStream.file);
 
 	std::cout << "100...Done!\n" << std::flush;
 
 }
 
-#endif // !FASTQ_H
\ No newline at end of file
+#endif // !FASTQ_H
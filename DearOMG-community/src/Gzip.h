@@ -0,0 +1,260 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+#include "zlib.h"
+#include "tbb/tbb.h"
+
+//=========================================================================
+// Decompresses .gz input for LoadFastqFile, which reads it like a FILE.
+// BGZF files (bgzip, most sequencer output) are a series of gzip members
+// of at most 64 KB that say their own size, so the members of every 16 MB
+// of input are inflated in parallel. Other files, including concatenated
+// gzip members, go through one zlib stream.
+//=========================================================================
+
+class GzipReader
+{
+public:
+	GzipReader(FILE* file) : file(file)
+	{
+		memset(&stream, 0, sizeof(stream));
+
+		input.resize(inputSize);
+		inputLen = fread(input.data(), 1, input.size(), file);
+		compressedBytes = inputLen;
+
+		if (inputLen < 2 || input[0] != 0x1f || input[1] != 0x8b)
+		{
+			std::cout << "[ERROR] The input file is not in gzip format!" << std::endl;
+			exit(0);
+		}
+
+		bgzf = BGZFBlockSize(0) > 0;
+
+		if (!bgzf)
+		{
+			// 16 + MAX_WBITS reads the gzip header and trailer
+			inflateInit2(&stream, 16 + MAX_WBITS);
+			stream.next_in = input.data();
+			stream.avail_in = (uInt)inputLen;
+		}
+	}
+
+	~GzipReader()
+	{
+		if (!bgzf) inflateEnd(&stream);
+	}
+
+	// Reads up to size bytes of decompressed data, fewer only at the end of the file.
+	size_t Read(char* buffer, size_t size)
+	{
+		size_t len = 0;
+
+		while (len < size)
+		{
+			if (bgzf)
+			{
+				if (outputPos == output.size() && !InflateBGZF()) break;
+
+				size_t chunk = std::min(size - len, output.size() - outputPos);
+				memcpy(buffer + len, output.data() + outputPos, chunk);
+
+				outputPos += chunk;
+				len += chunk;
+				continue;
+			}
+
+			if (stream.avail_in == 0)
+			{
+				if (!FillInput(inputLen))
+				{
+					if (memberOpen)
+					{
+						std::cout << "[ERROR] The gzip input is truncated!" << std::endl;
+						exit(0);
+					}
+					break;
+				}
+
+				stream.next_in = input.data();
+				stream.avail_in = (uInt)inputLen;
+			}
+
+			stream.next_out = (Bytef*)buffer + len;
+			stream.avail_out = (uInt)std::min(size - len, (size_t)UINT32_MAX);
+
+			uInt availIn = stream.avail_in;
+			int ret = inflate(&stream, Z_NO_FLUSH);
+			len = (char*)stream.next_out - buffer;
+
+			if (ret == Z_STREAM_END)
+			{
+				// another gzip member may follow
+				inflateReset(&stream);
+				memberOpen = false;
+			}
+			else if (stream.avail_in != availIn)
+			{
+				memberOpen = true;
+			}
+			else if (ret != Z_OK && ret != Z_BUF_ERROR)
+			{
+				std::cout << "[ERROR] The gzip input is corrupted!" << std::endl;
+				exit(0);
+			}
+			else if (ret == Z_BUF_ERROR && stream.avail_in > 0)
+			{
+				break;
+			}
+		}
+
+		outputBytes += len;
+
+		return len;
+	}
+
+	// decompressed bytes per compressed byte so far
+	double Ratio()
+	{
+		return compressedBytes > 0 ? (double)outputBytes / compressedBytes : 1.0;
+	}
+
+private:
+	FILE* file;
+	bool bgzf = false;
+
+	const size_t inputSize = 16 * 1024 * 1024;
+	std::vector<unsigned char> input;
+	size_t inputLen = 0;
+
+	uint64_t compressedBytes = 0;
+	uint64_t outputBytes = 0;
+
+	z_stream stream;
+	// a gzip member has begun but not reached its trailer
+	bool memberOpen = true;
+
+	std::vector<char> output;
+	size_t outputPos = 0;
+
+	// Moves the bytes from keep on to the front of input and reads behind them.
+	bool FillInput(size_t keep)
+	{
+		size_t kept = inputLen - keep;
+		memmove(input.data(), input.data() + keep, kept);
+
+		size_t readLen = fread(input.data() + kept, 1, input.size() - kept, file);
+		inputLen = kept + readLen;
+		compressedBytes += readLen;
+
+		return readLen > 0;
+	}
+
+	// Size of the BGZF block at pos of input, 0 if it is none or incomplete.
+	size_t BGZFBlockSize(size_t pos)
+	{
+		const unsigned char* p = input.data() + pos;
+		size_t available = inputLen - pos;
+
+		if (available < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return 0;
+
+		size_t xlen = p[10] | (p[11] << 8);
+		if (available < 12 + xlen) return 0;
+
+		for (size_t i = 12; i + 4 <= 12 + xlen; i += 4 + (p[i + 2] | (p[i + 3] << 8)))
+		{
+			if (p[i] == 'B' && p[i + 1] == 'C' && (p[i + 2] | (p[i + 3] << 8)) == 2)
+			{
+				size_t blockSize = (p[i + 4] | (p[i + 5] << 8)) + 1;
+				return blockSize <= available ? blockSize : 0;
+			}
+		}
+
+		return 0;
+	}
+
+	// Inflates the BGZF blocks complete in input into output, in parallel.
+	bool InflateBGZF()
+	{
+		std::vector<size_t> blockStarts;
+		std::vector<size_t> outputStarts(1, 0);
+
+		size_t pos = 0;
+		while (true)
+		{
+			size_t blockSize = BGZFBlockSize(pos);
+
+			if (blockSize == 0)
+			{
+				if (blockStarts.size() > 0) break;
+				if (pos == inputLen) return false;
+
+				// the block is cut off by the end of input
+				if (!FillInput(pos))
+				{
+					if (inputLen > 0)
+					{
+						std::cout << "[ERROR] The BGZF input is corrupted or truncated!" << std::endl;
+						exit(0);
+					}
+					return false;
+				}
+				pos = 0;
+				continue;
+			}
+
+			const unsigned char* tail = input.data() + pos + blockSize - 4;
+			uint32_t outputSize = tail[0] | (tail[1] << 8) | (tail[2] << 16) | ((uint32_t)tail[3] << 24);
+
+			blockStarts.push_back(pos);
+			outputStarts.push_back(outputStarts.back() + outputSize);
+			pos += blockSize;
+		}
+
+		output.resize(outputStarts.back());
+		outputPos = 0;
+
+		tbb::parallel_for(size_t(0), blockStarts.size(), [&](size_t b)
+		{
+			const unsigned char* p = input.data() + blockStarts[b];
+			size_t xlen = p[10] | (p[11] << 8);
+			size_t blockSize = BGZFBlockSize(blockStarts[b]);
+
+			z_stream blockStream;
+			memset(&blockStream, 0, sizeof(blockStream));
+			inflateInit2(&blockStream, -MAX_WBITS);
+
+			blockStream.next_in = (Bytef*)p + 12 + xlen;
+			blockStream.avail_in = (uInt)(blockSize - 12 - xlen - 8);
+			blockStream.next_out = (Bytef*)output.data() + outputStarts[b];
+			blockStream.avail_out = (uInt)(outputStarts[b + 1] - outputStarts[b]);
+
+			int ret = inflate(&blockStream, Z_FINISH);
+			inflateEnd(&blockStream);
+
+			const unsigned char* trailer = p + blockSize - 8;
+			uint32_t crc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+
+			if (ret != Z_STREAM_END ||
+				crc32(0, (const Bytef*)output.data() + outputStarts[b], (uInt)(outputStarts[b + 1] - outputStarts[b])) != crc)
+			{
+				std::cout << "[ERROR] The BGZF input is corrupted!" << std::endl;
+				exit(0);
+			}
+		});
+
+		// the blocks left are cut off by the end of input
+		FillInput(pos);
+
+		return true;
+	}
+};
+
+
+#endif // !GZIP_H
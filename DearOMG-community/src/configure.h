@@ -55,6 +55,156 @@ void DearOMG::ReadConfigure(int argc, char* argv[])
 				}
 			}
 
+			if (line.find("--pef") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				pefMz = sub.find("mz") != sub.npos;
+				pefIntensity = sub.find("intensity") != sub.npos;
+				pefMobility = sub.find("mobility") != sub.npos;
+				pefIdentifier = sub.find("identifier") != sub.npos;
+				pefQuality = sub.find("quality") != sub.npos;
+			}
+
+			if (line.find("--codec") != line.npos)
+			{
+				int pos = line.find("=");
+				codecPolicy = line.substr(pos + 1);
+
+				if (codecPolicy != "ef" && codecPolicy != "smallest" && codecPolicy != "fastest")
+				{
+					std::cout << "[ERROR] unknown codec policy " + codecPolicy + ", use ef, smallest or fastest." << std::endl;
+					exit(0);
+				}
+			}
+
+			if (line.find("--dict_samples") != line.npos)
+			{
+				int pos = line.find("=");
+				dictSamples = std::stoi(line.substr(pos + 1));
+			}
+
+			if (line.find("--superblock") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				size_t unit = 0;
+				if (sub.find("KB") != sub.npos) unit = KB;
+				else if (sub.find("MB") != sub.npos) unit = MB;
+				else if (sub.find("B") != sub.npos) unit = 1;
+
+				if (unit == 0)
+				{
+					superblockEntries = std::stoul(sub);
+				}
+				else
+				{
+					superblockBytes = std::stoull(sub) * unit;
+				}
+			}
+
+			if (line.find("--level") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				int colon = sub.find(":");
+				if (colon == sub.npos)
+				{
+					minZstdLevel = maxZstdLevel = std::stoi(sub);
+				}
+				else
+				{
+					minZstdLevel = std::stoi(sub.substr(0, colon));
+					maxZstdLevel = std::stoi(sub.substr(colon + 1));
+				}
+
+				if (minZstdLevel < 1 || maxZstdLevel > ZSTD_maxCLevel() || minZstdLevel > maxZstdLevel)
+				{
+					std::cout << "[ERROR] zstd level should be within 1:" << ZSTD_maxCLevel() << "!" << std::endl;
+					exit(0);
+				}
+			}
+
+			if (line.find("--long") != line.npos)
+			{
+				int pos = line.find("=");
+				longMatching = line.substr(pos + 1) == "1";
+			}
+
+			if (line.find("--paired") != line.npos)
+			{
+				int pos = line.find("=");
+				pairedEnd = line.substr(pos + 1) == "1";
+			}
+
+			if (line.find("--quality_codec") != line.npos)
+			{
+				int pos = line.find("=");
+				qualityCodec = line.substr(pos + 1);
+
+				if (qualityCodec != "rle" && qualityCodec != "fqz")
+				{
+					std::cout << "[ERROR] unknown quality codec " + qualityCodec + ", use rle or fqz." << std::endl;
+					exit(0);
+				}
+			}
+
+			if (line.find("--append") != line.npos)
+			{
+				int pos = line.find("=");
+				appendFile = line.substr(pos + 1);
+
+				for (int j = 0; j < appendFile.length(); ++j)
+				{
+					if (appendFile[j] == '\\') appendFile[j] = '/';
+				}
+			}
+
+			if (line.find("--merge") != line.npos)
+			{
+				int pos = line.find("=");
+				mergeFile = line.substr(pos + 1);
+
+				for (int j = 0; j < mergeFile.length(); ++j)
+				{
+					if (mergeFile[j] == '\\') mergeFile[j] = '/';
+				}
+			}
+
+			if (line.find("--split") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				size_t unit = 0;
+				if (sub.find("KB") != sub.npos) unit = KB;
+				else if (sub.find("MB") != sub.npos) unit = MB;
+				else if (sub.find("GB") != sub.npos) unit = (size_t)KB * MB;
+				else if (sub.find("B") != sub.npos) unit = 1;
+
+				int colon = sub.find(":");
+				if (colon != sub.npos)
+				{
+					splitColumn = sub.substr(0, colon);
+					splitWidth = std::stod(sub.substr(colon + 1));
+				}
+				else if (sub.find_first_not_of("0123456789") == sub.npos)
+				{
+					splitEntries = std::stoull(sub);
+				}
+				else if (unit > 0 && isdigit(sub[0]))
+				{
+					splitBytes = std::stoull(sub) * unit;
+				}
+				else
+				{
+					splitColumn = sub;
+				}
+			}
+
 			if (line.find("--out_dir") != line.npos)
 			{
 				int pos = line.find("=");
@@ -89,7 +239,30 @@ void DearOMG::ReadConfigure(int argc, char* argv[])
 			}
 		}
 
-		if (outputDir.length() == 0)
+		bool splitting = splitEntries > 0 || splitBytes > 0 || splitColumn.length() > 0;
+
+		if (mergeFile.length() > 0 || splitting)
+		{
+			// merged and split entries are copied, not converted
+			if (writeMode.length() == 0) writeMode = "binary";
+			if (mzPrecision < 0.0f) mzPrecision = 0.0;
+
+			if (appendFile.length() > 0 || writeMode != "binary" || (mergeFile.length() > 0 && splitting))
+			{
+				std::cout << "[ERROR] --merge and --split write new binary OMG files, they cannot be used together, with --append or another write mode!" << std::endl;
+				exit(0);
+			}
+			for (int i = 0; i < inputFileList.size(); ++i)
+			{
+				if (GetInputFileNameAndSuffix(inputFileList[i])[1] != "omg" || inputFileList[i] == mergeFile)
+				{
+					std::cout << "[ERROR] --merge and --split only take binary OMG files other than the output!" << std::endl;
+					exit(0);
+				}
+			}
+		}
+
+		if (outputDir.length() == 0 && appendFile.length() == 0 && mergeFile.length() == 0)
 		{
 			printf("\nThere is no parameter of output directory: --out_dir\n");
 			printf(HELP_INFO.c_str());
@@ -113,6 +286,31 @@ void DearOMG::ReadConfigure(int argc, char* argv[])
 			printf(HELP_INFO.c_str());
 			exit(0);
 		}
+		if (PackSuperblocks() && writeMode != "binary")
+		{
+			std::cout << "[ERROR] --superblock only supports binary write mode!" << std::endl;
+			exit(0);
+		}
+		if (appendFile.length() > 0 && writeMode != "binary")
+		{
+			std::cout << "[ERROR] --append only supports binary write mode!" << std::endl;
+			exit(0);
+		}
+		if (pairedEnd && writeMode != "binary")
+		{
+			std::cout << "[ERROR] --paired only supports binary write mode!" << std::endl;
+			exit(0);
+		}
+		if (pairedEnd && inputFileList.size() % 2 != 0)
+		{
+			std::cout << "[ERROR] --paired takes the R1 and R2 files of every pair!" << std::endl;
+			exit(0);
+		}
+		if (PackSuperblocks() && dictSamples > 0)
+		{
+			std::cout << "[WARNING] --dict_samples is ignored with --superblock!" << std::endl;
+			dictSamples = 0;
+		}
 	}
 
 #endif // !DEBUG
@@ -3,486 +3,558 @@
 
 #include "namespace.h"
 #include "eliasfano.h"
+#include "nucleotide.h"
+#include "qualitycodec.h"
 #include "utility.h"
 
-void DearOMG::EncodeGenomics(int nThreads, std::string inputFile)
+void DearOMG::EncodeGenomics(int nThreads, std::string inputFile, std::string mateFile)
 {
 	std::vector<std::string> nameSuffix = GetInputFileNameAndSuffix(inputFile);
 
-	std::string tmpFileName = outputDir + nameSuffix[0] + ".omg.tmp";
-
-	FILE* tmpFile = fopen(tmpFileName.c_str(), "wb");
+	std::vector< std::vector<uint64_t> > offsetVectorTmp;
 
-	if (!tmpFile)
+	// the leading parameters of every binary entry, kept as footer columns
+	metaColumns =
 	{
-		std::cout << "[ERROR] Cannot create " << tmpFileName << "\n"
-			<< "[ERROR] Please check your file or directory!" << std::endl;
-		exit(0);
-	}
+		MakeOMGColumn("readStartId", OMG_COLUMN_UINT32),
+		MakeOMGColumn("readEndId", OMG_COLUMN_UINT32)
+	};
+
+	// BasicInfo lines known before the input is read, checked against an --append file up front
+	std::string codecTag = codecPolicy == "ef" ? "0" : "1";
+	std::string knownInfo = " omics: Genomics\n writeFormat: " + writeMode + "\n codecTag: " + codecTag + "\n" +
+		(pairedEnd ? " pairedEnd: 1\n" : "") + (qualityCodec == "fqz" ? " qualityCodec: fqz\n" : "");
 
 	uint64_t startPos = 0;
-	std::vector< std::vector<uint64_t> > offsetVectorTmp;
+	FILE* payloadFile = OpenPayloadFile(nameSuffix[0], startPos, knownInfo);
 
-	tbb::parallel_pipeline(nThreads,
-		tbb::make_filter<void, GenoData>(tbb::filter::serial_out_of_order,
-			[&](tbb::flow_control& fc)
+	// Splits every identifier into tokens at ':' and ' ', the space kept as a "\t" token.
+	auto splitIdentifiers = [&](FastqLines& lines)
+	{
+		std::vector< std::vector<std::string> > splitTokens;
+
+		for (int i = 0; i < lines.lineStarts.size(); i += 4)
+		{
+			const char* identifier = lines.chunk.get() + lines.lineStarts[i];
+
+			std::string token = "";
+			std::vector<std::string> tokenList;
+
+			for (int j = 0; j < lines.lineLengths[i]; ++j)
 			{
-				GenoData genoData;
-				genoQueue.pop(genoData);
+				if (identifier[j] == ':')
+				{
+					tokenList.push_back(token);
+					token = "";
+					continue;
+				}
 
-				if (genoData.stop)
+				if (identifier[j] == ' ')
 				{
-					fc.stop();
+					tokenList.push_back(token);
+					tokenList.push_back("\t");
+					token = "";
+					continue;
 				}
 
-				return genoData;
-			}) &
-		tbb::make_filter<GenoData, std::string>(tbb::filter::parallel,
-			[&](GenoData genoData)
+				token += identifier[j];
+			}
+			if (token.length() > 0) tokenList.push_back(token);
+
+			splitTokens.push_back(tokenList);
+		}
+
+		return splitTokens;
+	};
+
+	// Keys and values of the identifier tokens, column by column. A column
+	// equal in every read to the same column of shareTokens, the identifiers
+	// of the other mate, is keyed "\n", which no token holds, and not stored again.
+	auto encodeIdentifiers = [&](std::vector< std::vector<std::string> >& splitTokens,
+		std::vector< std::vector<std::string> >* shareTokens,
+		std::string& identifierKeys, std::vector<char>& idValueCahrData)
+	{
+		int columns = splitTokens[0].size();
+
+		std::vector<int> isDigit(columns, 1);
+		for (int i = 0; i < columns; ++i)
+		{
+			for (int j = 0; j < splitTokens[0][i].length(); ++j)
 			{
-				if (genoData.readsData.size() == 0)
+				if (splitTokens[0][i][j] < '0' || splitTokens[0][i][j] > '9')
 				{
-					std::string empty = "";
-					return empty;
+					isDigit[i] = 0;
+					break;
 				}
+			}
+		}
 
-				std::string qualityStr = "";
-				std::string baseSequence = "";
-				std::vector<std::string> identifider;
+		std::vector<uint32_t> identifierValue;
 
-				for (int i = 0; i < genoData.readsData.size(); ++i)
+		for (int j = 0; j < columns; ++j)
+		{
+			if (shareTokens != NULL)
+			{
+				bool shared = true;
+				for (int i = 0; i < splitTokens.size() && shared; ++i)
 				{
-					if ((i & 3) == 0) // identifier (read ID)
-					{
-						identifider.push_back(genoData.readsData[i]);
-					}
-					if ((i & 3) == 1) // sequence: ATGC
-					{
-						baseSequence += genoData.readsData[i];
-					}
-					if ((i & 3) == 3) // quality score
-					{
-						qualityStr += genoData.readsData[i];
-					}
+					shared = j < splitTokens[i].size() && j < (*shareTokens)[i].size() &&
+						splitTokens[i][j] == (*shareTokens)[i][j];
 				}
 
-				if (identifider.size() == 0 ||
-					baseSequence.length() == 0 ||
-					qualityStr.length() == 0)
+				if (shared)
 				{
-					std::string empty = "";
-					return empty;
+					identifierKeys += "\n;";
+					continue;
 				}
+			}
 
-				Char2UInt32 char2uint32;
-
-				//========================================================
-				//	process identifier
-				//========================================================
-				std::vector< std::vector<std::string> > splitTokens;
+			int value = 0;
+			tsl::robin_map<std::string, int> columMap;
+			for (int i = 0; i < splitTokens.size(); ++i)
+			{
+				std::string key = splitTokens[i][j];
+				if (columMap.find(key) == columMap.end())
+				{
+					columMap[key] = value;
+					++value;
+				}
+			}
 
-				for (int i = 0; i < identifider.size(); ++i)
+			if (columMap.size() == 1)
+			{
+				identifierKeys += splitTokens[0][j] + ";";
+			}
+			else
+			{
+				if (isDigit[j] == 1)
 				{
-					std::string token = "";
-					std::vector<std::string> tokenList;
+					identifierKeys += "?;";
 
-					for (int j = 0; j < identifider[i].length(); ++j)
+					for (int i = 0; i < splitTokens.size(); ++i)
 					{
-						if (identifider[i][j] == ':')
-						{
-							tokenList.push_back(token);
-							token = "";
-							continue;
-						}
-
-						if (identifider[i][j] == ' ')
-						{
-							tokenList.push_back(token);
-							tokenList.push_back("\t");
-							token = "";
-							continue;
-						}
-
-						token += identifider[i][j];
+						identifierValue.push_back((uint32_t)stoi(splitTokens[i][j]));
 					}
-					if (token.length() > 0) tokenList.push_back(token);
-
-					splitTokens.push_back(tokenList);
 				}
-
-				int columns = splitTokens[0].size();
-
-				std::vector<int> isDigit(columns, 1);
-				for (int i = 0; i < columns; ++i)
+				else
 				{
-					for (int j = 0; j < splitTokens[0][i].length(); ++j)
+					for (auto it = columMap.begin(); it != columMap.end(); ++it)
 					{
-						if (splitTokens[0][i][j] < '0' || splitTokens[0][i][j] > '9')
-						{
-							isDigit[i] = 0;
-							break;
-						}
+						identifierKeys += it.key() + ",";
+						identifierValue.push_back((uint32_t)it.value());
 					}
+					identifierKeys += ";";
 				}
+			}
+		}
+		identifierKeys.pop_back();
 
-				std::string identifierKeys = "";
-				std::vector<uint32_t> identifierValue;
+		for (int i = 1; i < identifierValue.size(); ++i)
+		{
+			identifierValue[i] += identifierValue[i - 1];
+		}
 
-				for (int j = 0; j < columns; ++j)
-				{
-					int value = 0;
-					tsl::robin_map<std::string, int> columMap;
-					for (int i = 0; i < splitTokens.size(); ++i)
-					{
-						std::string key = splitTokens[i][j];
-						if (columMap.find(key) == columMap.end())
-						{
-							columMap[key] = value;
-							++value;
-						}
-					}
+		EncodeIntegers<uint32_t>(identifierValue, pefIdentifier, idValueCahrData);
+	};
 
-					if (columMap.size() == 1)
-					{
-						identifierKeys += splitTokens[0][j] + ";";
-					}
-					else
-					{
-						if (isDigit[j] == 1)
-						{
-							identifierKeys += "?;";
-
-							for (int i = 0; i < splitTokens.size(); ++i)
-							{
-								identifierValue.push_back((uint32_t)stoi(splitTokens[i][j]));
-							}
-						}
-						else
-						{
-							for (auto it = columMap.begin(); it != columMap.end(); ++it)
-							{
-								identifierKeys += it.key() + ",";
-								identifierValue.push_back((uint32_t)it.value());
-							}
-							identifierKeys += ";";
-						}
-					}
-				}
-				identifierKeys.pop_back();
+	// 2 bits per base, N bases stored as A and listed in NBaseCharData.
+	auto encodeSequence = [&](std::string& baseSequence, int zstdLevel,
+		std::vector<char>& seqCompData, std::vector<char>& NBaseCharData)
+	{
+		Char2UInt32 char2uint32;
 
-				for (int i = 1; i < identifierValue.size(); ++i)
-				{
-					identifierValue[i] += identifierValue[i - 1];
-				}
+		std::vector<uint32_t> NBasePos;
+		std::vector<char> seqBinaryEncode(Nucleotide::packedSize(baseSequence.size()));
+		Nucleotide::pack(baseSequence.data(), baseSequence.size(), seqBinaryEncode.data(), NBasePos);
 
-				std::vector<uint32_t> idEFCode;
-				EliasFanoEncode32(identifierValue, idEFCode);
+		ZSTDEncode(seqBinaryEncode, seqCompData, "seq", zstdLevel);
 
-				std::vector<char> idValueCahrData;
-				for (int i = 0; i < idEFCode.size(); ++i)
-				{
-					char2uint32.UInt32 = idEFCode[i];
-					for (int j = 0; j < 4; ++j)
-					{
-						idValueCahrData.push_back(char2uint32.Char[j]);
-					}
-				}
+		for (int i = 0; i < NBasePos.size(); ++i)
+		{
+			char2uint32.UInt32 = NBasePos[i];
+			for (int j = 0; j < 4; ++j)
+			{
+				NBaseCharData.push_back(char2uint32.Char[j]);
+			}
+		}
+	};
+
+	// Quality scores ranked by frequency into qKeyChars, and runs of one score
+	// as accumulated { rank, run length } pairs. One score alone needs no runs.
+	// --quality_codec=fqz codes the scores with a context model instead.
+	auto encodeQuality = [&](std::string& qualityStr, int zstdLevel, uint32_t readLength,
+		std::string& qKeyChars, std::vector<char>& qualityCompData)
+	{
+		if (qualityCodec == "fqz")
+		{
+			std::string alphabet = "";
+			QualityCodec::Encode(qualityStr.data(), qualityStr.length(), readLength, alphabet, qualityCompData);
 
-				std::string idKey = "";
-				std::string idValue = "";
+			qKeyChars += alphabet;
+			return;
+		}
 
-				if (writeMode == "json")
-				{
-					std::vector<char> idValueCode;
-					Base64Encode(idValueCahrData, idValueCode);
+		std::vector<int> consecNumber;
+		std::vector<char> qualityScore;
 
-					idKey = "  \"idKey\": \"" + identifierKeys + "\",\n";
+		int prevNum = 0;
+		char prevChar = qualityStr[0];
 
-					idValue = "  \"idValue\": \"";
-					idValue.append(idValueCode.begin(), idValueCode.end());
-					idValue.append("\",\n");
-				}
-				if (writeMode == "yaml")
-				{
-					std::vector<char> idValueCode;
-					Base64Encode(idValueCahrData, idValueCode);
+		tsl::robin_map<char, int> counter;
 
-					idKey = " idKey: " + identifierKeys + "\n";
+		for (int i = 0; i < qualityStr.length(); ++i)
+		{
+			if (counter.find(qualityStr[i]) == counter.end())
+			{
+				counter[qualityStr[i]] = 1;
+			}
+			else
+			{
+				counter[qualityStr[i]] += 1;
+			}
 
-					idValue = " idValue: ";
-					idValue.append(idValueCode.begin(), idValueCode.end());
-					idValue.append("\n");
-				}
+			if (qualityStr[i] == prevChar)
+			{
+				++prevNum;
+			}
+			else
+			{
+				qualityScore.push_back(prevChar);
+				consecNumber.push_back(prevNum);
 
-				if (writeMode == "binary")
-				{
-					idKey = identifierKeys;
-					idValue.append(idValueCahrData.begin(), idValueCahrData.end());
-				}
+				prevNum = 1;
+				prevChar = qualityStr[i];
+			}
+		}
 
-				//========================================================
-				//	process gene sequence
-				//========================================================
-				int k = 0;
-				std::bitset<8> bitBase;
-				std::vector<uint32_t> NBasePos;
-				std::vector<char> seqBinaryEncode;
+		if (counter.size() > 1)
+		{
+			std::vector< std::pair<char, int> > sortCounter;
 
-				std::string checkBase = "";
+			for (auto it = counter.begin(); it != counter.end(); ++it)
+			{
+				sortCounter.push_back(std::make_pair(it.key(), it.value()));
+			}
 
-				for (int i = 0; i < baseSequence.size(); ++i)
+			std::sort(sortCounter.begin(), sortCounter.end(),
+				[](std::pair<char, int>& x, std::pair<char, int>& y)
 				{
-					if (k >= 8)
-					{
-						k = 0;
-						seqBinaryEncode.push_back((char)(bitBase.to_ulong()));
-						bitBase.reset();
-					}
-					if (baseSequence[i] == 'A') // A: 00
-					{
-						k += 2;
-					}
-					if (baseSequence[i] == 'T') // T: 01
-					{
-						bitBase.set(6 - k);
-						k += 2;
-					}
-					if (baseSequence[i] == 'G') // G: 10
-					{
-						bitBase.set(7 - k);
-						k += 2;
-					}
-					if (baseSequence[i] == 'C') // C: 11
-					{
-						bitBase.set(7 - k);
-						bitBase.set(6 - k);
-						k += 2;
-					}
-					if (baseSequence[i] == 'N') // use "A" base to replace "N" base
-					{
-						k += 2;
-						NBasePos.push_back(i);
-					}
-					checkBase += baseSequence[i];
-				}
+					return x.second > y.second;
+				});
 
-				std::vector<char> seqCompData;
-				ZSTDEncode(seqBinaryEncode, seqCompData);
+			for (int j = 0; j < sortCounter.size(); ++j)
+			{
+				counter[sortCounter[j].first] = j;
+				qKeyChars += sortCounter[j].first;
+			}
 
-				std::vector<char> NBaseCharData;
-				for (int i = 0; i < NBasePos.size(); ++i)
-				{
-					char2uint32.UInt32 = NBasePos[i];
-					for (int j = 0; j < 4; ++j)
-					{
-						NBaseCharData.push_back(char2uint32.Char[j]);
-					}
-				}
+			uint32_t accumulated = 0;
+			std::vector<uint32_t> qualityArr;
 
-				std::string seqCode = "";
-				std::string NBasePosCode = "";
+			for (int j = 0; j < qualityScore.size(); ++j)
+			{
+				accumulated += counter[qualityScore[j]];
+				qualityArr.push_back(accumulated);
+
+				accumulated += consecNumber[j];
+				qualityArr.push_back(accumulated);
+			}
+
+			std::vector<char> qualityCharData;
+			EncodeIntegers<uint32_t>(qualityArr, pefQuality, qualityCharData);
+			ZSTDEncode(qualityCharData, qualityCompData, "qValue", zstdLevel);
+		}
+		else
+		{
+			for (auto it = counter.begin(); it != counter.end(); ++it)
+			{
+				qKeyChars += it.key();
+			}
+		}
+	};
 
-				if (writeMode == "json" || writeMode == "yaml")
-				{
-					std::vector<char> seqB64Code;
-					std::vector<char> NBasePosB64Code;
+	// the sequences and quality scores of a batch, each concatenated
+	auto joinReads = [](FastqLines& lines, std::string& baseSequence, std::string& qualityStr)
+	{
+		for (int i = 0; i < lines.lineStarts.size(); ++i)
+		{
+			const char* line = lines.chunk.get() + lines.lineStarts[i];
 
-					Base64Encode(seqCompData, seqB64Code);
-					Base64Encode(NBaseCharData, NBasePosB64Code);
+			if ((i & 3) == 1) // sequence: ATGC
+			{
+				baseSequence.append(line, lines.lineLengths[i]);
+			}
+			if ((i & 3) == 3) // quality score
+			{
+				qualityStr.append(line, lines.lineLengths[i]);
+			}
+		}
+	};
 
-					if (writeMode == "yaml") seqCode = " seq: ";
-					if (writeMode == "json") seqCode = "  \"seq\": \"";
+	// Encodes one entry. TrainDictionaries also runs it over the sampled entries.
+	auto encodeEntry = [&](GenoData genoData)
+	{
+		std::string qualityStr = "";
+		std::string baseSequence = "";
+		joinReads(genoData.reads, baseSequence, qualityStr);
 
-					seqCode.append(seqB64Code.begin(), seqB64Code.end());
-					NBasePosCode.append(NBasePosB64Code.begin(), NBasePosB64Code.end());
+		std::vector< std::vector<std::string> > splitTokens = splitIdentifiers(genoData.reads);
 
-					if (writeMode == "yaml") seqCode += "\n";
-					if (writeMode == "json") seqCode += "\",\n";
-				}
-				if (writeMode == "binary")
-				{
-					seqCode.append(seqCompData.begin(), seqCompData.end());
-					NBasePosCode.append(NBaseCharData.begin(), NBaseCharData.end());
-				}
+		if (splitTokens.size() == 0 ||
+			baseSequence.length() == 0 ||
+			qualityStr.length() == 0)
+		{
+			std::string empty = "";
+			return empty;
+		}
 
-				//========================================================
-				//	process quality score
-				//========================================================
+		Char2UInt32 char2uint32;
 
-				std::vector<int> consecNumber;
-				std::vector<char> qualityScore;
+		//========================================================
+		//	process identifier
+		//========================================================
+		std::string identifierKeys = "";
+		std::vector<char> idValueCahrData;
+		encodeIdentifiers(splitTokens, NULL, identifierKeys, idValueCahrData);
 
-				int prevNum = 0;
-				char prevChar = qualityStr[0];
+		std::string idKey = "";
+		std::string idValue = "";
 
-				tsl::robin_map<char, int> counter;
+		if (writeMode == "json")
+		{
+			std::vector<char> idValueCode;
+			Base64Encode(idValueCahrData, idValueCode);
 
-				for (int i = 0; i < qualityStr.length(); ++i)
-				{
-					if (counter.find(qualityStr[i]) == counter.end())
-					{
-						counter[qualityStr[i]] = 1;
-					}
-					else
-					{
-						counter[qualityStr[i]] += 1;
-					}
+			idKey = "  \"idKey\": \"" + identifierKeys + "\",\n";
 
-					if (qualityStr[i] == prevChar)
-					{
-						++prevNum;
-					}
-					else
-					{
-						qualityScore.push_back(prevChar);
-						consecNumber.push_back(prevNum);
+			idValue = "  \"idValue\": \"";
+			idValue.append(idValueCode.begin(), idValueCode.end());
+			idValue.append("\",\n");
+		}
+		if (writeMode == "yaml")
+		{
+			std::vector<char> idValueCode;
+			Base64Encode(idValueCahrData, idValueCode);
 
-						prevNum = 1;
-						prevChar = qualityStr[i];
-					}
-				}
+			idKey = " idKey: " + identifierKeys + "\n";
 
-				std::string qKey = "";
-				if (writeMode == "yaml") qKey = " qKey: ";
-				if (writeMode == "json") qKey = "  \"qKey\": \"";
+			idValue = " idValue: ";
+			idValue.append(idValueCode.begin(), idValueCode.end());
+			idValue.append("\n");
+		}
 
-				std::vector<char> qualityCompData;
-				std::vector<uint32_t> qualityEFCode;
+		if (writeMode == "binary")
+		{
+			idKey = identifierKeys;
+			idValue.append(idValueCahrData.begin(), idValueCahrData.end());
+		}
 
-				if (counter.size() > 1)
-				{
-					std::vector< std::pair<char, int> > sortCounter;
+		//========================================================
+		//	process gene sequence
+		//========================================================
+		std::vector<char> seqCompData;
+		std::vector<char> NBaseCharData;
+		encodeSequence(baseSequence, genoData.zstdLevel, seqCompData, NBaseCharData);
 
-					for (auto it = counter.begin(); it != counter.end(); ++it)
-					{
-						sortCounter.push_back(std::make_pair(it.key(), it.value()));
-					}
+		std::string seqCode = "";
+		std::string NBasePosCode = "";
 
-					std::sort(sortCounter.begin(), sortCounter.end(),
-						[](std::pair<char, int>& x, std::pair<char, int>& y)
-						{
-							return x.second > y.second;
-						});
+		if (writeMode == "json" || writeMode == "yaml")
+		{
+			std::vector<char> seqB64Code;
+			std::vector<char> NBasePosB64Code;
 
-					for (int j = 0; j < sortCounter.size(); ++j)
-					{
-						counter[sortCounter[j].first] = j;
-						qKey += sortCounter[j].first;
-					}
+			Base64Encode(seqCompData, seqB64Code);
+			Base64Encode(NBaseCharData, NBasePosB64Code);
 
-					uint32_t accumulated = 0;
-					std::vector<uint32_t> qualityArr;
+			if (writeMode == "yaml") seqCode = " seq: ";
+			if (writeMode == "json") seqCode = "  \"seq\": \"";
 
-					for (int j = 0; j < qualityScore.size(); ++j)
-					{
-						accumulated += counter[qualityScore[j]];
-						qualityArr.push_back(accumulated);
+			seqCode.append(seqB64Code.begin(), seqB64Code.end());
+			NBasePosCode.append(NBasePosB64Code.begin(), NBasePosB64Code.end());
 
-						accumulated += consecNumber[j];
-						qualityArr.push_back(accumulated);
-					}
-					EliasFanoEncode32(qualityArr, qualityEFCode);
+			if (writeMode == "yaml") seqCode += "\n";
+			if (writeMode == "json") seqCode += "\",\n";
+		}
+		if (writeMode == "binary")
+		{
+			seqCode.append(seqCompData.begin(), seqCompData.end());
+			NBasePosCode.append(NBaseCharData.begin(), NBaseCharData.end());
+		}
 
-					std::vector<char> qualityCharData;
-					for (int i = 0; i < qualityEFCode.size(); ++i)
-					{
-						char2uint32.UInt32 = qualityEFCode[i];
-						for (int j = 0; j < 4; ++j)
-						{
-							qualityCharData.push_back(char2uint32.Char[j]);
-						}
-					}
-					ZSTDEncode(qualityCharData, qualityCompData);
-				}
-				else
-				{
-					for (auto it = counter.begin(); it != counter.end(); ++it)
-					{
-						qKey += it.key();
-					}
-				}
+		//========================================================
+		//	process quality score
+		//========================================================
+		std::string qKey = "";
+		if (writeMode == "yaml") qKey = " qKey: ";
+		if (writeMode == "json") qKey = "  \"qKey\": \"";
 
-				if (writeMode == "yaml") qKey += "\n";
-				if (writeMode == "json") qKey += "\",\n";
+		// the reads of a file are as long as its first one
+		uint32_t readLength = (uint32_t)std::stoul(genoHeader.readLength);
 
-				std::string qValue = "";
+		std::vector<char> qualityCompData;
+		encodeQuality(qualityStr, genoData.zstdLevel, readLength, qKey, qualityCompData);
 
-				if (writeMode == "json" || writeMode == "yaml")
-				{
-					std::vector<char> qValueCode;
-					Base64Encode(qualityCompData, qValueCode);
+		if (writeMode == "yaml") qKey += "\n";
+		if (writeMode == "json") qKey += "\",\n";
 
-					if (writeMode == "yaml") qValue = " qValue: ";
-					if (writeMode == "json") qValue = "  \"qValue\": \"";
+		std::string qValue = "";
 
-					qValue.append(qValueCode.begin(), qValueCode.end());
+		if (writeMode == "json" || writeMode == "yaml")
+		{
+			std::vector<char> qValueCode;
+			Base64Encode(qualityCompData, qValueCode);
 
-					if (writeMode == "yaml") qValue += "\n\n";
-					if (writeMode == "json") qValue += "\"\n },\n";
-				}
-				if (writeMode == "binary")
-				{
-					qValue.append(qualityCompData.begin(), qualityCompData.end());
-				}
+			if (writeMode == "yaml") qValue = " qValue: ";
+			if (writeMode == "json") qValue = "  \"qValue\": \"";
+
+			qValue.append(qValueCode.begin(), qValueCode.end());
+
+			if (writeMode == "yaml") qValue += "\n\n";
+			if (writeMode == "json") qValue += "\"\n },\n";
+		}
+		if (writeMode == "binary")
+		{
+			qValue.append(qualityCompData.begin(), qualityCompData.end());
+		}
+
+		//========================================================
+		//	process the R2 mates, binary only
+		//========================================================
+		std::vector<std::string> mateSections;
+
+		if (pairedEnd)
+		{
+			std::string mateQualityStr = "";
+			std::string mateSequence = "";
+			joinReads(genoData.mateReads, mateSequence, mateQualityStr);
+
+			std::vector< std::vector<std::string> > mateTokens = splitIdentifiers(genoData.mateReads);
+
+			std::string mateIdKey = "";
+			std::vector<char> mateIdValue;
+			encodeIdentifiers(mateTokens, &splitTokens, mateIdKey, mateIdValue);
+
+			std::vector<char> mateSeqCompData;
+			std::vector<char> mateNBaseCharData;
+			encodeSequence(mateSequence, genoData.zstdLevel, mateSeqCompData, mateNBaseCharData);
+
+			std::string mateQKey = "";
+			uint32_t mateReadLength = (uint32_t)std::stoul(genoHeader.mateReadLength);
+			std::vector<char> mateQualityCompData;
+			encodeQuality(mateQualityStr, genoData.zstdLevel, mateReadLength, mateQKey, mateQualityCompData);
 
-				std::string readInfo = "";
-				char2uint32.UInt32 = genoData.readStartId;
-				for (int i = 0; i < 4; ++i)
+			mateSections =
+			{
+				mateIdKey,
+				std::string(mateIdValue.begin(), mateIdValue.end()),
+				std::string(mateSeqCompData.begin(), mateSeqCompData.end()),
+				std::string(mateNBaseCharData.begin(), mateNBaseCharData.end()),
+				mateQKey,
+				std::string(mateQualityCompData.begin(), mateQualityCompData.end())
+			};
+		}
+
+		// the entry ID and zstd level lead the string for the writer, which drops them
+		std::string readInfo = "";
+		std::vector<uint32_t> writerInfo = { genoData.readStartId, (uint32_t)genoData.zstdLevel };
+		for (int i = 0; i < writerInfo.size(); ++i)
+		{
+			char2uint32.UInt32 = writerInfo[i];
+			for (int j = 0; j < 4; ++j)
+			{
+				readInfo += char2uint32.Char[j];
+			}
+		}
+
+		if (writeMode == "yaml")
+		{
+			readInfo += "read_"
+				+ std::to_string(genoData.readStartId) + "-"
+				+ std::to_string(genoData.readEndId) + ":\n"
+				+ idKey + idValue 
+				+ seqCode + NBasePosCode
+				+ qKey + qValue;
+		}
+		if (writeMode == "json")
+		{
+			readInfo += " \"read_" + std::to_string(genoData.readStartId) + "-"
+				+ std::to_string(genoData.readEndId) + "\": {\n"
+				+ idKey + idValue
+				+ seqCode + NBasePosCode
+				+ qKey + qValue;
+		}
+		if (writeMode == "binary")
+		{
+			std::vector<uint32_t> paramsUInt =
+			{
+				genoData.readStartId,
+				genoData.readEndId,
+				(uint32_t)idKey.length(),
+				(uint32_t)idValue.length(),
+				(uint32_t)seqCode.length(),
+				(uint32_t)NBasePosCode.length(),
+				(uint32_t)qKey.length(),
+				(uint32_t)qValue.length()
+			};
+			for (int i = 0; i < mateSections.size(); ++i)
+			{
+				paramsUInt.push_back((uint32_t)mateSections[i].length());
+			}
+
+			Char2UInt32 char2uint32;
+			for (int i = 0; i < paramsUInt.size(); ++i)
+			{
+				char2uint32.UInt32 = paramsUInt[i];
+				for (int j = 0; j < 4; ++j)
 				{
-					readInfo += char2uint32.Char[i];
+					readInfo += char2uint32.Char[j];
 				}
+			}
+
+			readInfo += idKey + idValue
+				+ seqCode + NBasePosCode
+				+ qKey + qValue;
+			for (int i = 0; i < mateSections.size(); ++i)
+			{
+				readInfo += mateSections[i];
+			}
+		}
+
+		return readInfo;
+	};
+
+	std::deque<GenoData> sampledData;
+	TrainDictionaries(genoQueue, sampledData, encodeEntry);
+	ResetZSTDLevel();
 
-				if (writeMode == "yaml")
+	tbb::parallel_pipeline(nThreads,
+		tbb::make_filter<void, GenoData>(tbb::filter::serial_out_of_order,
+			[&](tbb::flow_control& fc)
+			{
+				GenoData genoData;
+				if (sampledData.empty())
 				{
-					readInfo = "read_"
-						+ std::to_string(genoData.readStartId) + "-"
-						+ std::to_string(genoData.readEndId) + ":\n"
-						+ idKey + idValue 
-						+ seqCode + NBasePosCode
-						+ qKey + qValue;
+					genoQueue.pop(genoData);
 				}
-				if (writeMode == "json")
+				else
 				{
-					readInfo = " \"read_" + std::to_string(genoData.readStartId) + "-"
-						+ std::to_string(genoData.readEndId) + "\": {\n"
-						+ idKey + idValue
-						+ seqCode + NBasePosCode
-						+ qKey + qValue;
+					genoData = sampledData.front();
+					sampledData.pop_front();
 				}
-				if (writeMode == "binary")
-				{
-					std::vector<uint32_t> paramsUInt =
-					{
-						genoData.readStartId,
-						genoData.readEndId,
-						(uint32_t)idKey.length(),
-						(uint32_t)idValue.length(),
-						(uint32_t)seqCode.length(),
-						(uint32_t)NBasePosCode.length(),
-						(uint32_t)qKey.length(),
-						(uint32_t)qValue.length()
-					};
-
-					Char2UInt32 char2uint32;
-					for (int i = 0; i < paramsUInt.size(); ++i)
-					{
-						char2uint32.UInt32 = paramsUInt[i];
-						for (int j = 0; j < 4; ++j)
-						{
-							readInfo += char2uint32.Char[j];
-						}
-					}
 
-					readInfo += idKey + idValue
-						+ seqCode + NBasePosCode
-						+ qKey + qValue;
+				if (genoData.stop)
+				{
+					fc.stop();
 				}
 
-				return readInfo;
+				genoData.zstdLevel = AdaptZSTDLevel(genoQueue.size(), nThreads);
 
+				return genoData;
 			}) &
+		tbb::make_filter<GenoData, std::string>(tbb::filter::parallel, encodeEntry) &
 
-		tbb::make_filter<std::string, void>(tbb::filter::serial_out_of_order,
+		tbb::make_filter<std::string, void>(PackSuperblocks() ? tbb::filter::serial_in_order : tbb::filter::serial_out_of_order,
 			[&](std::string readInfo)
 			{
 				if (readInfo.length() == 0)
@@ -491,23 +563,25 @@ void DearOMG::EncodeGenomics(int nThreads, std::string inputFile)
 				}
 
 				Char2UInt32 char2uint32;
-				for (int i = 0; i < 4; ++i)
+				std::vector<uint64_t> writerInfo(2);
+				for (int i = 0; i < writerInfo.size(); ++i)
 				{
-					char2uint32.Char[i] = readInfo[i];
+					for (int j = 0; j < 4; ++j)
+					{
+						char2uint32.Char[j] = readInfo[i * 4 + j];
+					}
+					writerInfo[i] = char2uint32.UInt32;
 				}
 
-				fwrite(readInfo.c_str() + 4, 1, readInfo.length() - 4, tmpFile);
-				
-				std::vector<uint64_t> tmp = { char2uint32.UInt32, startPos, readInfo.length() };
-				offsetVectorTmp.push_back(tmp);
-
-				startPos += readInfo.length();
+				WriteEntry(payloadFile, startPos, offsetVectorTmp, writerInfo[0], (int)writerInfo[1],
+					readInfo.c_str() + 8, readInfo.length() - 8);
 
 				return NULL;
 			})
 		);
 
-	fclose(tmpFile);
+	FlushSuperblock(payloadFile, startPos);
+	fclose(payloadFile);
 
 	tbb::parallel_sort(offsetVectorTmp.begin(), offsetVectorTmp.end(),
 		[](std::vector<uint64_t>& x, std::vector<uint64_t>& y)
@@ -531,8 +605,11 @@ void DearOMG::EncodeGenomics(int nThreads, std::string inputFile)
 			"  \"date\": \"" + date + "\",\n"
 			"  \"parentFile\": \"" + inputFile + "\",\n"
 			"  \"parentFormat\": \"" + nameSuffix[1] + "\"\n"
+			"  \"codecTag\": \"" + codecTag + "\",\n" +
+			DictionaryInfo() +
 			"  \"readLength\": \"" + genoHeader.readLength + "\"\n"
-			"  \"readCount\": \"" + genoHeader.readCount + "\"\n"
+			"  \"readCount\": \"" + genoHeader.readCount + "\"\n" +
+			(qualityCodec == "fqz" ? "  \"qualityCodec\": \"fqz\"\n" : "") +
 			" },\n";
 	}
 	if (writeMode == "yaml" || writeMode == "binary")
@@ -543,9 +620,22 @@ void DearOMG::EncodeGenomics(int nThreads, std::string inputFile)
 			" date: " + date + "\n"
 			" parentFile: " + inputFile + "\n"
 			" parentFormat: " + nameSuffix[1] + "\n"
+			" codecTag: " + codecTag + "\n" +
+			DictionaryInfo() +
 			" readLength: " + genoHeader.readLength + "\n"
-			" readCount: " + genoHeader.readCount + "\n"
-			"\n";
+			" readCount: " + genoHeader.readCount + "\n";
+
+		if (pairedEnd)
+		{
+			baseInfo += " pairedEnd: 1\n"
+				" mateFile: " + mateFile + "\n"
+				" mateReadLength: " + genoHeader.mateReadLength + "\n";
+		}
+		if (qualityCodec == "fqz")
+		{
+			baseInfo += " qualityCodec: fqz\n";
+		}
+		baseInfo += "\n";
 	}
 
 	ReWriteOMGFile(inputFile, nameSuffix[0], baseInfo, offsetVectorTmp);
@@ -11,6 +11,8 @@
 #include "genomics.h"
 #include "proteomics.h"
 #include "metabolomics.h"
+#include "merge.h"
+#include "split.h"
 
 #include "Fastq.h"
 #include "ImzML.h"
@@ -23,7 +25,15 @@ void DearOMG::RunConverter()
 
 	std::cout << "===========================[Dear-OMG]=================================\n";
 
-	for (int fid = 0; fid < inputFileList.size(); ++fid)
+	if (mergeFile.length() > 0)
+	{
+		// the first file is copied as it is, the others are merged into the copy
+		std::cout << "[INFO] Copy file 0: " << inputFileList[0] << "\n";
+		CopyOMGFile(inputFileList[0], mergeFile);
+		appendFile = mergeFile;
+	}
+
+	for (int fid = mergeFile.length() > 0 ? 1 : 0; fid < inputFileList.size(); ++fid)
 	{
 		clock_t runStartTime = clock();
 
@@ -39,24 +49,39 @@ void DearOMG::RunConverter()
 			dataReader = std::thread(&DearOMG::LoadBrukerTDFFile, this, inputFile);
 			EncodeProteomics(nThreads, inputFile);
 		}
-		else if (nameSuffix[1] == "fastq")
+		else if (nameSuffix[1] == "fastq" || nameSuffix[1] == "fastq.gz")
 		{
-			dataReader = std::thread(&DearOMG::LoadFastqFile, this, inputFile);
-			EncodeGenomics(nThreads, inputFile);
+			// the R2 file of a pair follows its R1 file
+			std::string mateFile = pairedEnd ? inputFileList[++fid] : "";
+			if (pairedEnd) std::cout << "[INFO] Its mate file: " << mateFile << "\n";
+
+			dataReader = std::thread(&DearOMG::LoadFastqFile, this, inputFile, mateFile);
+			EncodeGenomics(nThreads, inputFile, mateFile);
 		}
 		else if (nameSuffix[1] == "imzML")
 		{
 			dataReader = std::thread(&DearOMG::LoadImzMLFile, this, inputFile);
 			EncodeMetabolomics(nThreads, inputFile);
 		}
+		else if (nameSuffix[1] == "omg")
+		{
+			if (splitEntries > 0 || splitBytes > 0 || splitColumn.length() > 0)
+			{
+				SplitOMGFile(inputFile);
+			}
+			else
+			{
+				MergeOMGFile(inputFile);
+			}
+		}
 		else
 		{
 			std::cout << "[ERROR] Error format!\n"
-				<< "[INFO] DearOMG-community.exe supports *.d, *.imzML and *.faseq formats!\n";
+				<< "[INFO] DearOMG-community.exe supports *.d, *.imzML, *.faseq, *.fastq.gz and *.omg formats!\n";
 			exit(0);
 		}
 		
-		dataReader.join();
+		if (dataReader.joinable()) dataReader.join();
 
 		std::cout << "[INFO] Done! Conversion time: " << (double)(clock() - runStartTime) / CLOCKS_PER_SEC << " seconds." << std::endl;
 
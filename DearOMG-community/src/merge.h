@@ -0,0 +1,290 @@
+#ifndef MERGE_H
+#define MERGE_H
+
+#include "namespace.h"
+#include "utility.h"
+
+// Copies a binary OMG file as it is, the first file of --merge.
+void DearOMG::CopyOMGFile(std::string inputFile, std::string outputFile)
+{
+	OMGIndex omgIndex;
+	LoadOMGIndex(inputFile, omgIndex);
+
+	FILE* fromFile = fopen(inputFile.c_str(), "rb");
+	FILE* toFile = fopen(outputFile.c_str(), "wb");
+
+	if (!fromFile || !toFile)
+	{
+		std::cout << "[ERROR] Cannot create " << outputFile << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	std::vector<char> buffer;
+	CopyFileBytes(fromFile, 0, toFile, omgIndex.fileSize, buffer);
+
+	fclose(fromFile);
+	fclose(toFile);
+}
+
+// Decompresses a superblock of count entries, the first one firstEntry, sets
+// the idColumns words of every entry to their values in offsetVectorTmp and
+// compresses it again at level into compData, left empty if the superblock
+// does not hold count entries.
+void DearOMG::RenumberSuperblock(const char* data, uint64_t size,
+	std::vector< std::vector<uint64_t> >& offsetVectorTmp, uint64_t firstEntry, uint64_t count,
+	std::vector<int>& idColumns, int level, std::vector<char>& compData)
+{
+	compData.clear();
+
+	unsigned long long blockSize = ZSTD_getFrameContentSize(data, size);
+	if (blockSize == ZSTD_CONTENTSIZE_ERROR || blockSize == ZSTD_CONTENTSIZE_UNKNOWN) return;
+
+	std::vector<char> block(blockSize);
+	size_t decompSize = ZSTD_decompress(block.data(), block.size(), data, size);
+	if (ZSTD_isError(decompSize) || decompSize != block.size() || block.size() < sizeof(uint32_t)) return;
+
+	// [entry count][entry sizes][entries], see FlushSuperblock
+	uint32_t blockCount;
+	memcpy(&blockCount, block.data(), sizeof(uint32_t));
+
+	uint64_t entryPos = (count + 1) * sizeof(uint32_t);
+	if (blockCount != count || entryPos > block.size()) return;
+
+	for (uint64_t e = 0; e < count; ++e)
+	{
+		uint32_t entrySize;
+		memcpy(&entrySize, block.data() + (e + 1) * sizeof(uint32_t), sizeof(uint32_t));
+		if (entrySize > block.size() - entryPos) return;
+
+		for (int k : idColumns)
+		{
+			if ((k + 1) * sizeof(uint32_t) > entrySize) continue;
+
+			uint32_t word = (uint32_t)offsetVectorTmp[firstEntry + e][k + 5];
+			memcpy(block.data() + entryPos + k * sizeof(uint32_t), &word, sizeof(uint32_t));
+		}
+		entryPos += entrySize;
+	}
+
+	compData.resize(ZSTD_compressBound(block.size()));
+	size_t compSize = ZSTD_compress2(ZSTDContextAt(level), compData.data(), compData.size(), block.data(), block.size());
+
+	if (ZSTD_isError(compSize))
+	{
+		std::cout << "[ERROR] Something was wrong in compressing superblock!" << std::endl;
+		exit(0);
+	}
+	compData.resize(compSize);
+}
+
+// Appends the entries of a binary OMG file to the --append file without
+// decoding their arrays: the stored blocks are copied in file order and a new
+// footer indexes them after the old ones. Entry ids (scanIndex, spectrumId,
+// readStartId/readEndId) continue from the largest one of the file merged
+// into, both in the footer columns and in the leading words of the entries.
+// Superblocks are copied as they are, one zstd frame each, unless their ids
+// move: then each one is decompressed, renumbered and compressed again at
+// its level.
+void DearOMG::MergeOMGFile(std::string inputFile)
+{
+	if (appendFile.length() == 0)
+	{
+		std::cout << "[ERROR] Binary OMG files can only be merged, use --merge or --append!" << std::endl;
+		exit(0);
+	}
+
+	OMGIndex source;
+	LoadOMGIndex(inputFile, source);
+	LoadOMGIndex(appendFile, appendTarget);
+
+	OMGFooter& footer = source.footer;
+	OMGFooter& targetFooter = appendTarget.footer;
+	bool packed = (footer.flags & OMG_FOOTER_SUPERBLOCKS) != 0;
+
+	if (packed != ((targetFooter.flags & OMG_FOOTER_SUPERBLOCKS) != 0))
+	{
+		std::cout << "[ERROR] Cannot merge " << inputFile << " into " << appendFile << ", only one of them uses superblocks!" << std::endl;
+		exit(0);
+	}
+
+	OMGTables tables = MapOMGTables(source);
+	metaColumns.assign(tables.columns, tables.columns + footer.columnCount);
+
+	// both files must agree on their columns, decode keys and dictionaries
+	// before a byte is copied
+	CheckAppendTarget(source.basicInfo);
+
+	// the id columns, and where the ids of the merged entries start
+	std::vector<int> idColumns = IdColumns();
+	uint64_t idShift = NextEntryId(appendTarget, idColumns);
+
+	// { entryId, offset or superblock, size, zstd level, CRC32C } and the columns, as WriteEntry keeps them
+	std::vector< std::vector<uint64_t> > offsetVectorTmp(footer.entryCount);
+	for (uint64_t i = 0; i < footer.entryCount; ++i)
+	{
+		std::vector<uint64_t>& tmp = offsetVectorTmp[i];
+		tmp = { i, 0, 0, 0, 0 };
+
+		for (int k = 0; k < metaColumns.size(); ++k)
+		{
+			uint64_t value = tables.values[k * tables.columnStride + i];
+			if (std::find(idColumns.begin(), idColumns.end(), k) != idColumns.end()) value += idShift;
+
+			tmp.push_back((uint32_t)value);
+		}
+	}
+
+	BeginAppend();
+
+	// not "ab": copy_file_range refuses a file opened for appending
+	FILE* fromFile = fopen(inputFile.c_str(), "rb");
+	FILE* toFile = fopen(appendFile.c_str(), "r+b");
+
+	if (!fromFile || !toFile)
+	{
+		std::cout << "[ERROR] Cannot merge " << inputFile << " into " << appendFile << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	fseek(toFile, 0, SEEK_END);
+
+	std::vector<uint64_t> fileOrder(footer.blockCount);
+	for (uint64_t b = 0; b < footer.blockCount; ++b)
+	{
+		fileOrder[b] = b;
+	}
+	std::sort(fileOrder.begin(), fileOrder.end(), [&](uint64_t x, uint64_t y)
+	{
+		return tables.blocks[2 * x] < tables.blocks[2 * y];
+	});
+
+	uint64_t startPos = appendTarget.fileSize;
+	std::vector< std::vector<uint64_t> > superblocks(packed ? footer.blockCount : 0);
+	bool renumber = idShift > 0 && !idColumns.empty();
+	std::vector<char> buffer;
+	fpos_t ptrPos;
+
+	// blocks adjacent in the file are copied together, in runs of up to 64 MB
+	for (uint64_t first = 0, last = 0; first < fileOrder.size(); first = last)
+	{
+		uint64_t runStart = tables.blocks[2 * fileOrder[first]];
+		uint64_t runEnd = runStart + tables.blocks[2 * fileOrder[first] + 1];
+
+		for (last = first + 1; last < fileOrder.size(); ++last)
+		{
+			uint64_t offset = tables.blocks[2 * fileOrder[last]];
+			if (offset != runEnd || runEnd - runStart >= 64 * MB) break;
+
+			runEnd = offset + tables.blocks[2 * fileOrder[last] + 1];
+		}
+
+		if (packed && !renumber)
+		{
+			// superblocks keep their bytes and checksums
+			for (uint64_t j = first; j < last; ++j)
+			{
+				uint64_t b = fileOrder[j];
+				uint64_t count = (b + 1 < footer.blockCount ? tables.firstEntries[b + 1] : footer.entryCount) - tables.firstEntries[b];
+
+				superblocks[b] = { startPos + tables.blocks[2 * b] - runStart, tables.blocks[2 * b + 1],
+					(uint64_t)tables.levels[b], count, tables.checksums[b] };
+			}
+
+			CopyFileBytes(fromFile, runStart, toFile, runEnd - runStart, buffer);
+			startPos += runEnd - runStart;
+			continue;
+		}
+
+		if (buffer.size() < runEnd - runStart) buffer.resize(runEnd - runStart);
+
+#ifdef _WIN32
+		ptrPos = runStart;
+#endif // !_WIN32
+
+#ifdef __linux__
+		ptrPos.__pos = runStart;
+#endif // __linux__
+
+		fsetpos(fromFile, &ptrPos);
+
+		if (fread(buffer.data(), sizeof(char), runEnd - runStart, fromFile) != runEnd - runStart)
+		{
+			std::cout << "[ERROR] Cannot read " << inputFile << "!" << std::endl;
+			exit(0);
+		}
+
+		for (uint64_t j = first; j < last; ++j)
+		{
+			uint64_t b = fileOrder[j];
+			char* data = buffer.data() + (tables.blocks[2 * b] - runStart);
+			uint64_t size = tables.blocks[2 * b + 1];
+
+			if (CRC32C::Compute(data, size) != tables.checksums[b])
+			{
+				std::cout << "[ERROR] Block " << b << " of " << inputFile << " is corrupted!" << std::endl;
+				exit(0);
+			}
+
+			if (packed)
+			{
+				uint64_t count = (b + 1 < footer.blockCount ? tables.firstEntries[b + 1] : footer.entryCount) - tables.firstEntries[b];
+				std::vector<char> compData;
+				RenumberSuperblock(data, size, offsetVectorTmp, tables.firstEntries[b], count, idColumns, (int)tables.levels[b], compData);
+
+				if (compData.size() == 0)
+				{
+					std::cout << "[ERROR] Block " << b << " of " << inputFile << " is corrupted!" << std::endl;
+					exit(0);
+				}
+
+				if (fwrite(compData.data(), sizeof(char), compData.size(), toFile) != compData.size())
+				{
+					std::cout << "[ERROR] Cannot write " << appendFile << "!" << std::endl;
+					exit(0);
+				}
+
+				superblocks[b] = { startPos, compData.size(), (uint64_t)tables.levels[b], count,
+					CRC32C::Compute(compData.data(), compData.size()) };
+				startPos += compData.size();
+				continue;
+			}
+
+			for (int k : idColumns)
+			{
+				if ((k + 1) * sizeof(uint32_t) > size) continue;
+
+				uint32_t word = (uint32_t)offsetVectorTmp[b][k + 5];
+				memcpy(data + k * sizeof(uint32_t), &word, sizeof(uint32_t));
+			}
+
+			offsetVectorTmp[b][1] = startPos + tables.blocks[2 * b] - runStart;
+			offsetVectorTmp[b][2] = size;
+			offsetVectorTmp[b][3] = (uint64_t)tables.levels[b];
+			offsetVectorTmp[b][4] = CRC32C::Compute(data, size);
+		}
+
+		if (packed) continue;
+
+		if (fwrite(buffer.data(), sizeof(char), runEnd - runStart, toFile) != runEnd - runStart)
+		{
+			std::cout << "[ERROR] Cannot write " << appendFile << "!" << std::endl;
+			exit(0);
+		}
+		startPos += runEnd - runStart;
+	}
+
+	fclose(fromFile);
+	fclose(toFile);
+
+	superblockTable = superblocks;
+
+	std::string fileName = "";
+	AppendOMGFooter(fileName, source.basicInfo, offsetVectorTmp, packed);
+
+	std::cout << "[INFO] Merged " << footer.entryCount << " entries of " << inputFile << " into " << appendFile << std::endl;
+}
+
+
+#endif // !MERGE_H
@@ -14,24 +14,37 @@
 #include <bitset>
 #include <vector>
 #include <string>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <iostream>
 
+#ifdef __linux__
+#include <unistd.h>
+#endif // __linux__
+
 #include "zstd.h"
+#include "zdict.h"
 #include "zlib.h"
 #include "zconf.h"
 #include "Base64.h"
+#include "omgfooter.h"
+#include "omgwriter.h"
 #include "sqlite3.h"
 #include "tbb/tbb.h"
 #include "tsl/robin_map.h"
 #include "tsl/robin_set.h"
 
+#define	KB 1024
 #define	MB 1048576
 
-class DearOMG
+class DearOMG : public OMGWriter
 {
 public:
 	DearOMG(int argc, char* argv[])
@@ -45,14 +58,38 @@ public:
 	//=========================================================================
 	// Custom parameters
 	//=========================================================================
-	std::string writeMode;
-	std::string outputDir;
 	std::vector<std::string> inputFileList;
 
 	double mzPrecision = -1.0;
 	bool writeMobility = false;
 	bool skipZeroIntensity = true;
 
+	// arrays written as partitioned Elias-Fano
+	bool pefMz = false;
+	bool pefIntensity = false;
+	bool pefMobility = false;
+	bool pefIdentifier = false;
+	bool pefQuality = false;
+
+	// ef keeps the legacy untagged streams, smallest/fastest pick a codec per array
+	std::string codecPolicy = "ef";
+
+	// new binary .omg file the input .omg files are merged into, none for no merge
+	std::string mergeFile = "";
+
+	// shards --split cuts input .omg files into: consecutive blocks by entry count
+	// or by bytes, or windows of a footer column, one value per shard without a width
+	uint64_t splitEntries = 0;
+	uint64_t splitBytes = 0;
+	std::string splitColumn = "";
+	double splitWidth = 0.0;
+
+	// consecutive .fastq inputs are the R1 and R2 files of a pair, encoded together
+	bool pairedEnd = false;
+
+	// quality scores: rle runs of ranked scores, or fqz, a context model with rANS
+	std::string qualityCodec = "rle";
+
 	int fastqBatchSize = 512;
 	size_t fastqBufferSize = 10 * MB;
 	size_t xmlBufferSize = 10 * MB;
@@ -76,8 +113,19 @@ private:
 		"\n--write_mode:\tdata storage type. " + SOFTWARE_NAME + " support binary, json, yaml. defalut=binary.\n"
 		"\n--precision:\tprecision of m/z array. defalut=0.001.\n"
 		"\n--skip_zero:\tskip ions with zero intensity or not. true for 1 and false for 0. defalut=1.\n"
+		"\n--pef:\tarrays encoded with partitioned Elias-Fano, e.g. mz;identifier. options: mz, intensity, mobility, identifier, quality. defalut=none.\n"
+		"\n--codec:\tinteger codec policy. options: ef, smallest, fastest. defalut=ef.\n"
+		"\n--dict_samples:\tentries sampled to train one zstd dictionary per array type, 0 for none. defalut=0.\n"
+		"\n--superblock:\tentries packed into one zstd frame, a count (e.g. 64) or a size (e.g. 512KB, 4MB). binary mode only. defalut=none.\n"
+		"\n--level:\tzstd level, or a min:max range adapted to the spare capacity of the machine, e.g. 1:9. defalut=1.\n"
+		"\n--long:\tlong distance matching at the top of the level range. true for 1 and false for 0. defalut=0.\n"
+		"\n--append:\tbinary OMG file to add the converted entries to, instead of writing new files to --out_dir. defalut=none.\n"
+		"\n--quality_codec:\tquality score codec of *.fastq inputs. options: rle, fqz (context model, smaller). defalut=rle.\n"
+		"\n--paired:\tthe *.fastq inputs are R1/R2 pairs, R1 first, each pair written to one file. binary mode only. true for 1 and false for 0. defalut=0.\n"
+		"\n--split:\tcut the input *.omg files into shards in --out_dir, by entries (e.g. 100000), by size (e.g. 1GB) or by a column window (e.g. RT:300, msLevel). defalut=none.\n"
+		"\n--merge:\tnew binary OMG file to merge the input *.omg files into, without decoding them. defalut=none.\n"
 		"\n--out_dir:\toutput directory or path.\n" +
-		"\n--input:\tinput file list. " + SOFTWARE_NAME + " supports *.wiff, *.raw, *.d, *.imzML, *.fastq formats.\n" +
+		"\n--input:\tinput file list. " + SOFTWARE_NAME + " supports *.wiff, *.raw, *.d, *.imzML, *.fastq, *.fastq.gz formats.\n" +
 		"\nNote: the paths of input files and output directory should not include 'Space'.\n\n";
 
 	//=====================================================================//
@@ -104,6 +152,7 @@ private:
 	{
 		std::string readCount = "";
 		std::string readLength = "";
+		std::string mateReadLength = "";
 	};
 
 	struct MetaHeader
@@ -147,6 +196,8 @@ private:
 		float precursorMz;
 		float collisionEnergy;
 
+		int zstdLevel = 1;
+
 		std::string info;
 		std::string mzEncode;
 		std::string mobilityEncode;
@@ -156,13 +207,27 @@ private:
 		std::vector< std::vector<double> > spectrum;
 	};
 
+	// 4 lines per read, the lineLengths[i] bytes at lineStarts[i] of the
+	// chunk LoadFastqFile read them in, '\n' and '\r' excluded
+	struct FastqLines
+	{
+		std::shared_ptr<char> chunk;
+		std::vector<uint32_t> lineStarts;
+		std::vector<uint32_t> lineLengths;
+	};
+
 	struct GenoData // save to disk
 	{
 		bool stop = false;
 
 		uint32_t readEndId;
 		uint32_t readStartId;
-		std::vector<std::string> readsData;
+
+		// the reads, and with --paired the same reads of the R2 file
+		FastqLines reads;
+		FastqLines mateReads;
+
+		int zstdLevel = 1;
 	};
 
 	struct MetaData
@@ -182,6 +247,8 @@ private:
 		std::string position3D_y = "NA";
 		std::string position3D_z = "NA";
 
+		int zstdLevel = 1;
+
 		std::string info;
 		std::string mzEncode;
 		std::string intensityEncode;
@@ -220,13 +287,7 @@ private:
 	//=====================================================================//
 	void ReadConfigure(int argc, char* argv[]);
 
-	void EliasFanoEncode32(std::vector<uint32_t>& x, std::vector<uint32_t>& EFCode);
-	void EliasFanoDecode32(std::vector<uint32_t>& EFCode, std::vector<uint32_t>& x);
-
-	void EliasFanoEncode64(std::vector<uint64_t>& x, std::vector<uint64_t>& EFCode);
-	void EliasFanoDecode64(std::vector<uint64_t>& EFCode, std::vector<uint64_t>& x);
-
-	void LoadFastqFile(std::string inputFile);
+	void LoadFastqFile(std::string inputFile, std::string mateFile);
 
 	void LoadBrukerTDFFile(std::string inputFolder);
 	void GetBrukerTDFBaseInfo(std::string inputFolder);
@@ -239,7 +300,7 @@ private:
 		std::vector<double>& decodeSpectrum,
 		int arrayLength, std::string compressType, std::string EncodeType);
 
-	void EncodeGenomics(int nThreads, std::string inputFile);
+	void EncodeGenomics(int nThreads, std::string inputFile, std::string mateFile);
 	void EncodeProteomics(int nThreads, std::string inputFile);
 	void EncodeMetabolomics(int nThreads, std::string inputFile);
 
@@ -247,12 +308,17 @@ private:
 	// Utilities
 	//=====================================================================//
 	std::string GetTime();
-	void ZSTDEncode(std::vector<char>& input, std::vector<char>& output);
 	void Base64Encode(std::vector<char>& input, std::vector<char>& output);
 
-	void ReWriteOMGFile(std::string& inputFile,
-		std::string& fileName, std::string& baseInfo,
-		std::vector< std::vector<uint64_t> >& offsetVectorTmp);
+	template <typename WordT, typename ValueT>
+	void EncodeIntegers(std::vector<ValueT>& x, bool partitioned, std::vector<char>& output);
+
+	void CopyOMGFile(std::string inputFile, std::string outputFile);
+	void RenumberSuperblock(const char* data, uint64_t size,
+		std::vector< std::vector<uint64_t> >& offsetVectorTmp, uint64_t firstEntry, uint64_t count,
+		std::vector<int>& idColumns, int level, std::vector<char>& compData);
+	void MergeOMGFile(std::string inputFile);
+	void SplitOMGFile(std::string inputFile);
 
 	std::vector<std::string> GetInputFileNameAndSuffix(std::string inputFileName);
 
@@ -0,0 +1,268 @@
+#ifndef SPLIT_H
+#define SPLIT_H
+
+#include "namespace.h"
+#include "utility.h"
+
+// Cuts a binary OMG file into shards that are binary OMG files of their own,
+// written to --out_dir as <name>.shard<k>.omg. Blocks are copied as they are
+// and keep their checksums and column values, so scanIndex, spectrumId and
+// read ids stay global. A shard holds consecutive blocks up to splitEntries
+// entries or splitBytes bytes, or the entries whose splitColumn value falls
+// in one splitWidth window. <name>.manifest.json lists the entries of every shard.
+void DearOMG::SplitOMGFile(std::string inputFile)
+{
+	OMGIndex source;
+	LoadOMGIndex(inputFile, source);
+
+	OMGFooter& footer = source.footer;
+	OMGTables tables = MapOMGTables(source);
+	bool packed = (footer.flags & OMG_FOOTER_SUPERBLOCKS) != 0;
+
+	metaColumns.assign(tables.columns, tables.columns + footer.columnCount);
+
+	auto firstEntry = [&](uint64_t b)
+	{
+		if (b == footer.blockCount) return footer.entryCount;
+		return packed ? tables.firstEntries[b] : b;
+	};
+
+	// the shard key of every block, shards follow in key order
+	std::vector<int64_t> blockKeys(footer.blockCount);
+
+	if (splitColumn.length() > 0)
+	{
+		int column = -1;
+		for (int k = 0; k < metaColumns.size(); ++k)
+		{
+			if (splitColumn == metaColumns[k].name) column = k;
+		}
+
+		if (column < 0)
+		{
+			std::cout << "[ERROR] " << inputFile << " has no column " << splitColumn << " to split by!" << std::endl;
+			exit(0);
+		}
+		if (packed)
+		{
+			std::cout << "[ERROR] The superblocks of " << inputFile << " can only be split by entries or bytes!" << std::endl;
+			exit(0);
+		}
+
+		double width = splitWidth > 0.0 ? splitWidth : 1.0;
+		const uint32_t* values = tables.values + column * tables.columnStride;
+
+		for (uint64_t b = 0; b < footer.blockCount; ++b)
+		{
+			double value = values[b];
+			if (metaColumns[column].type == OMG_COLUMN_FLOAT32)
+			{
+				float floatValue;
+				memcpy(&floatValue, values + b, sizeof(float));
+				value = floatValue;
+			}
+
+			blockKeys[b] = (int64_t)std::floor(value / width);
+		}
+	}
+	else
+	{
+		int64_t shard = 0;
+		uint64_t shardEntries = 0;
+		uint64_t shardBytes = 0;
+
+		for (uint64_t b = 0; b < footer.blockCount; ++b)
+		{
+			uint64_t entries = firstEntry(b + 1) - firstEntry(b);
+			uint64_t bytes = tables.blocks[2 * b + 1];
+
+			if (shardEntries > 0 && ((splitEntries > 0 && shardEntries + entries > splitEntries) ||
+				(splitBytes > 0 && shardBytes + bytes > splitBytes)))
+			{
+				++shard;
+				shardEntries = 0;
+				shardBytes = 0;
+			}
+
+			blockKeys[b] = shard;
+			shardEntries += entries;
+			shardBytes += bytes;
+		}
+	}
+
+	std::vector<int64_t> keys = blockKeys;
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	std::vector<std::string> nameSuffix = GetInputFileNameAndSuffix(inputFile);
+	std::string manifest = "{\n"
+		"  \"sourceFile\": \"" + inputFile + "\",\n"
+		"  \"entryCount\": " + std::to_string(footer.entryCount) + ",\n"
+		"  \"shards\": [\n";
+
+	FILE* fromFile = fopen(inputFile.c_str(), "rb");
+
+	if (!fromFile)
+	{
+		std::cout << "[ERROR] Cannot open " << inputFile << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	std::vector<char> buffer;
+
+	for (int s = 0; s < keys.size(); ++s)
+	{
+		std::vector<uint64_t> blocks;
+		for (uint64_t b = 0; b < footer.blockCount; ++b)
+		{
+			if (blockKeys[b] == keys[s]) blocks.push_back(b);
+		}
+
+		std::string shardName = nameSuffix[0] + ".shard" + std::to_string(s);
+		std::string shardFileName = outputDir + shardName + ".omg";
+
+		FILE* toFile = fopen(shardFileName.c_str(), "wb");
+
+		if (!toFile)
+		{
+			std::cout << "[ERROR] Cannot create " << shardFileName << "\n"
+				<< "[ERROR] Please check your file or directory!" << std::endl;
+			exit(0);
+		}
+
+		// { entryId, offset or superblock, size, zstd level, CRC32C } and the columns, as WriteEntry keeps them
+		std::vector< std::vector<uint64_t> > offsetVectorTmp;
+		std::vector<uint64_t> globalIds;
+
+		for (int j = 0; j < blocks.size(); ++j)
+		{
+			uint64_t b = blocks[j];
+
+			if (packed)
+			{
+				std::vector<uint64_t> tmp = { 0, tables.blocks[2 * b + 1], (uint64_t)tables.levels[b],
+					firstEntry(b + 1) - firstEntry(b), tables.checksums[b] };
+				superblockTable.push_back(tmp);
+			}
+
+			for (uint64_t i = firstEntry(b); i < firstEntry(b + 1); ++i)
+			{
+				std::vector<uint64_t> tmp = { offsetVectorTmp.size(), 0, tables.blocks[2 * b + 1],
+					(uint64_t)tables.levels[b], tables.checksums[b] };
+				for (int k = 0; k < metaColumns.size(); ++k)
+				{
+					tmp.push_back(tables.values[k * tables.columnStride + i]);
+				}
+
+				offsetVectorTmp.push_back(tmp);
+				globalIds.push_back(i);
+			}
+		}
+
+		// blocks are copied in file order, adjacent ones together
+		std::vector<int> fileOrder(blocks.size());
+		for (int j = 0; j < blocks.size(); ++j)
+		{
+			fileOrder[j] = j;
+		}
+		std::sort(fileOrder.begin(), fileOrder.end(), [&](int x, int y)
+		{
+			return tables.blocks[2 * blocks[x]] < tables.blocks[2 * blocks[y]];
+		});
+
+		uint64_t startPos = 0;
+		for (int first = 0, last = 0; first < fileOrder.size(); first = last)
+		{
+			uint64_t runStart = tables.blocks[2 * blocks[fileOrder[first]]];
+			uint64_t runEnd = runStart;
+
+			for (last = first; last < fileOrder.size(); ++last)
+			{
+				int j = fileOrder[last];
+				uint64_t offset = tables.blocks[2 * blocks[j]];
+				if (offset != runEnd) break;
+
+				// a block row of the shard: its superblock, or its only entry
+				uint64_t& shardOffset = packed ? superblockTable[j][0] : offsetVectorTmp[j][1];
+				shardOffset = startPos + offset - runStart;
+
+				runEnd = offset + tables.blocks[2 * blocks[j] + 1];
+			}
+
+			CopyFileBytes(fromFile, runStart, toFile, runEnd - runStart, buffer);
+			startPos += runEnd - runStart;
+		}
+
+		fclose(toFile);
+
+		// BasicInfo of the source, counting the entries of the shard
+		uint64_t readCount = 0;
+		for (int k = 0; k + 1 < metaColumns.size(); ++k)
+		{
+			if (std::string(metaColumns[k].name) != "readStartId" || std::string(metaColumns[k + 1].name) != "readEndId") continue;
+
+			for (int i = 0; i < offsetVectorTmp.size(); ++i)
+			{
+				readCount += offsetVectorTmp[i][k + 6] - offsetVectorTmp[i][k + 5] + 1;
+			}
+		}
+
+		std::string baseInfo = "";
+		std::stringstream stream(source.basicInfo);
+		std::string line;
+
+		while (std::getline(stream, line))
+		{
+			if (line.compare(0, 12, " readCount: ") == 0) line = " readCount: " + std::to_string(readCount);
+			if (line.compare(0, 12, " scanCount: ") == 0) line = " scanCount: " + std::to_string(offsetVectorTmp.size());
+			if (line.length() == 0) continue;
+
+			baseInfo += line + "\n";
+		}
+		baseInfo += " splitFile: " + inputFile + "\n"
+			" shardIndex: " + std::to_string(s) + "\n\n";
+
+		AppendOMGFooter(shardName, baseInfo, offsetVectorTmp, packed);
+
+		// global entry ids of the shard, as runs of consecutive ids
+		std::string entryRanges = "";
+		for (int i = 0, j = 0; i < globalIds.size(); i = j)
+		{
+			for (j = i + 1; j < globalIds.size() && globalIds[j] == globalIds[j - 1] + 1; ++j);
+
+			entryRanges += (i > 0 ? ", " : "") + std::string("[") + std::to_string(globalIds[i]) + ", " + std::to_string(globalIds[j - 1]) + "]";
+		}
+
+		manifest += std::string(s > 0 ? ",\n" : "") +
+			"    {\n"
+			"      \"file\": \"" + shardName + ".omg\",\n"
+			"      \"entryCount\": " + std::to_string(globalIds.size()) + ",\n"
+			"      \"firstEntry\": " + std::to_string(globalIds.front()) + ",\n"
+			"      \"lastEntry\": " + std::to_string(globalIds.back()) + ",\n"
+			"      \"entryRanges\": [" + entryRanges + "]\n"
+			"    }";
+	}
+
+	fclose(fromFile);
+
+	manifest += "\n  ]\n}\n";
+
+	std::string manifestFileName = outputDir + nameSuffix[0] + ".manifest.json";
+	std::ofstream manifestFile(manifestFileName);
+
+	if (!manifestFile)
+	{
+		std::cout << "[ERROR] Cannot create " << manifestFileName << "\n"
+			<< "[ERROR] Please check your file or directory!" << std::endl;
+		exit(0);
+	}
+
+	manifestFile << manifest;
+	manifestFile.close();
+
+	std::cout << "[INFO] Split " << footer.entryCount << " entries of " << inputFile << " into " << keys.size() << " shards" << std::endl;
+}
+
+
+#endif // !SPLIT_H
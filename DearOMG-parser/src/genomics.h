@@ -2,6 +2,9 @@
 #define GENOMICS_H
 
 #include "namespace.h"
+#include "codec.h"
+#include "nucleotide.h"
+#include "qualitycodec.h"
 
 OMGParser::EntryData OMGParser::GenomicsEntry(int entryId)
 {
@@ -10,28 +13,12 @@ OMGParser::EntryData OMGParser::GenomicsEntry(int entryId)
 
 	int readId = entryId;
 
-	uint64_t startPos = entryTable[readId][0];
-	uint64_t byteCount = entryTable[readId][1];
-
-	char* entryBuff = (char*)malloc(byteCount * sizeof(char));
-	if (readMode == "disk")
-	{
-		filePtrPos = startPos;
-		fsetpos(omgFilePtr, &filePtrPos);
-
-		size_t readSize = fread(entryBuff, sizeof(char), byteCount, omgFilePtr);
-	}
-	else if (readMode == "memory")
-	{
-		memcpy(entryBuff, fullFileBuffer + startPos, byteCount);
-	}
-
-	std::string entryString(entryBuff, entryBuff + byteCount);
-	free(entryBuff);
+	std::string entryString = ReadEntry(readId);
 
 	int batchSize = -1;
 	std::vector<std::string> keyList;
 	std::vector<std::string> valueList;
+	std::vector<std::string> mateValueList;
 
 	if (writeMode == "json" || writeMode == "yaml")
 	{
@@ -50,8 +37,11 @@ OMGParser::EntryData OMGParser::GenomicsEntry(int entryId)
 	{
 		keyList = { "idKey", "idValue", "seq", "npos", "qKey", "qValue" };
 
+		// paired files add the section lengths of the mates
+		int nParams = genoPaired ? 14 : 8;
+
 		std::vector<uint32_t> params;
-		for (int i = 0; i < 8; ++i)
+		for (int i = 0; i < nParams; ++i)
 		{
 			for (int j = 0; j < 4; ++j)
 			{
@@ -67,272 +57,292 @@ OMGParser::EntryData OMGParser::GenomicsEntry(int entryId)
 
 		batchSize = params[1] - params[0] + 1;
 
-		uint32_t stPos = 32;
-		for (int i = 2; i < params.size(); ++i)
+		uint32_t stPos = nParams * 4;
+		for (int i = 2; i < 8; ++i)
 		{
 			valueList.push_back(entryString.substr(stPos, params[i]));
 			stPos += params[i];
 		}
+		for (int i = 8; i < params.size(); ++i)
+		{
+			mateValueList.push_back(entryString.substr(stPos, params[i]));
+			stPos += params[i];
+		}
 	}
 	if (batchSize == -1)
 	{
 		std::cout << "Error in decode batch size!" << std::endl;
-		exit(0);
+		exit(1);
 	}
 
-	std::vector<uint32_t> identifierValue;
-	std::vector< std::vector<std::string> > idKeyList;
+	EntryData entry;
 
-	std::string baseSequence = "";
-	std::vector<uint32_t> NBasePos;
+	// Decodes the six sections of one mate of the reads into entry, under
+	// entryKeys { identifier, sequence, quality }, and keeps the identifier
+	// tokens of every read in readTokens.
+	auto decodeReads = [&](std::vector<std::string>& values, int readLen, std::vector<std::string> entryKeys,
+		std::vector< std::vector<std::string> >& readTokens, std::vector< std::vector<std::string> >* shareTokens)
+	{
+		std::vector<uint32_t> identifierValue;
+		std::vector< std::vector<std::string> > idKeyList;
 
-	std::vector<char> qKey;
-	std::vector<uint32_t> qualityArr;
+		std::string baseSequence = "";
+		std::vector<uint32_t> NBasePos;
 
-	for (int n = 0; n < keyList.size(); ++n)
-	{
-		if (keyList[n] == "idKey")
+		std::vector<char> qKey;
+		std::vector<uint32_t> qualityArr;
+		std::string qualityStr = "";
+
+		for (int n = 0; n < keyList.size(); ++n)
 		{
-			std::string token = "";
-			for (int i = 0; i < valueList[n].length(); ++i)
+			if (keyList[n] == "idKey")
 			{
-				if (valueList[n][i] == ';' || i == valueList[n].length() - 1)
+				std::string token = "";
+				for (int i = 0; i < values[n].length(); ++i)
 				{
-					if (i == valueList[n].length() - 1) token += valueList[n][i];
-
-					std::string k = "";
-					std::vector<std::string> columnKey;
-					for (int j = 0; j < token.length(); ++j)
+					if (values[n][i] == ';' || i == values[n].length() - 1)
 					{
-						if (token[j] == ',')
+						if (i == values[n].length() - 1) token += values[n][i];
+
+						std::string k = "";
+						std::vector<std::string> columnKey;
+						for (int j = 0; j < token.length(); ++j)
 						{
-							columnKey.push_back(k);
-							k = "";
+							if (token[j] == ',')
+							{
+								columnKey.push_back(k);
+								k = "";
+							}
+							k += token[j];
 						}
-						k += token[j];
-					}
-					if (k.length() > 0) columnKey.push_back(k);
+						if (k.length() > 0) columnKey.push_back(k);
 
-					idKeyList.push_back(columnKey);
-					token = "";
+						idKeyList.push_back(columnKey);
+						token = "";
 
-					continue;
+						continue;
+					}
+					token += values[n][i];
 				}
-				token += valueList[n][i];
 			}
-		}
-		if (keyList[n] == "idValue")
-		{
-			std::vector<char> src;
-			if (writeMode == "json" || writeMode == "yaml")
-			{
-				Base64Decode(valueList[n], src);
-			}
-			if (writeMode == "binary")
-			{
-				src.assign(valueList[n].begin(), valueList[n].end());
-			}
-
-			std::vector<uint32_t> idEFCode;
-			for (int j = 0; j < src.size() / 4; ++j)
+			if (keyList[n] == "idValue")
 			{
-				for (int k = 0; k < 4; ++k)
+				std::vector<char> src;
+				if (writeMode == "json" || writeMode == "yaml")
 				{
-					char2uint32.Char[k] = src[j * 4 + k];
+					Base64Decode(values[n], src);
+				}
+				if (writeMode == "binary")
+				{
+					src.assign(values[n].begin(), values[n].end());
 				}
-				idEFCode.push_back(char2uint32.UInt32);
-			}
 
-			std::vector<uint32_t> idDecodeValue;
-			EliasFanoDecode32(idEFCode, idDecodeValue);
+				std::vector<uint32_t> idDecodeValue;
+				DecodeIntegers<uint32_t>(src, idDecodeValue);
 
-			identifierValue.resize(idDecodeValue.size());
-			identifierValue[0] = idDecodeValue[0];
+				// identifiers may hold no varying column, those of mates often do not
+				if (idDecodeValue.size() == 0) continue;
 
-			for (int j = 1; j < idDecodeValue.size(); ++j)
-			{
-				identifierValue[j] = idDecodeValue[j] - idDecodeValue[j - 1];
-			}
-		}
-		if (keyList[n] == "seq")
-		{
-			std::vector<char> src;
-			if (writeMode == "json" || writeMode == "yaml")
-			{
-				Base64Decode(valueList[n], src);
-			}
-			if (writeMode == "binary")
-			{
-				src.assign(valueList[n].begin(), valueList[n].end());
-			}
-
-			std::vector<char> seqDecode;
-			ZSTDDecode(src, seqDecode);
-
-			for (int i = 0; i < seqDecode.size(); ++i)
-			{
-				std::bitset<8> bitChar(seqDecode[i]);
+				identifierValue.resize(idDecodeValue.size());
+				identifierValue[0] = idDecodeValue[0];
 
-				for (int j = 0; j < 4; ++j)
+				for (int j = 1; j < idDecodeValue.size(); ++j)
 				{
-					if (bitChar.test(7 - 2 * j) == false && bitChar.test(6 - 2 * j) == false) baseSequence += "A";
-					if (bitChar.test(7 - 2 * j) == false && bitChar.test(6 - 2 * j) == true) baseSequence += "T";
-					if (bitChar.test(7 - 2 * j) == true && bitChar.test(6 - 2 * j) == false) baseSequence += "G";
-					if (bitChar.test(7 - 2 * j) == true && bitChar.test(6 - 2 * j) == true) baseSequence += "C";
+					identifierValue[j] = idDecodeValue[j] - idDecodeValue[j - 1];
 				}
 			}
-		}
-		if (keyList[n] == "npos")
-		{
-			if (valueList[n].length() > 0)
+			if (keyList[n] == "seq")
 			{
 				std::vector<char> src;
 				if (writeMode == "json" || writeMode == "yaml")
 				{
-					Base64Decode(valueList[n], src);
+					Base64Decode(values[n], src);
 				}
 				if (writeMode == "binary")
 				{
-					src.assign(valueList[n].begin(), valueList[n].end());
+					src.assign(values[n].begin(), values[n].end());
 				}
 
-				for (int j = 0; j < src.size() / 4; ++j)
+				std::vector<char> seqDecode;
+				ZSTDDecode(src, seqDecode);
+
+				baseSequence.resize(seqDecode.size() * 4);
+				Nucleotide::unpack(seqDecode.data(), baseSequence.size(), &baseSequence[0]);
+			}
+			if (keyList[n] == "npos")
+			{
+				if (values[n].length() > 0)
 				{
-					for (int k = 0; k < 4; ++k)
+					std::vector<char> src;
+					if (writeMode == "json" || writeMode == "yaml")
+					{
+						Base64Decode(values[n], src);
+					}
+					if (writeMode == "binary")
+					{
+						src.assign(values[n].begin(), values[n].end());
+					}
+
+					for (int j = 0; j < src.size() / 4; ++j)
 					{
-						char2uint32.Char[k] = src[j * 4 + k];
+						for (int k = 0; k < 4; ++k)
+						{
+							char2uint32.Char[k] = src[j * 4 + k];
+						}
+						NBasePos.push_back(char2uint32.UInt32);
 					}
-					NBasePos.push_back(char2uint32.UInt32);
 				}
 			}
-		}
-		if (keyList[n] == "qKey")
-		{
-			qKey.assign(valueList[n].begin(), valueList[n].end());
-		}
-		if (keyList[n] == "qValue")
-		{
-			if (qKey.size() > 1)
+			if (keyList[n] == "qKey")
 			{
-				std::vector<char> qualityCompData;
-				if (writeMode == "json" || writeMode == "yaml")
-				{
-					Base64Decode(valueList[n], qualityCompData);
-				}
-				if (writeMode == "binary")
+				qKey.assign(values[n].begin(), values[n].end());
+			}
+			if (keyList[n] == "qValue")
+			{
+				if (qKey.size() > 1)
 				{
-					qualityCompData.assign(valueList[n].begin(), valueList[n].end());
-				}
-
-				std::vector<char> qualityCharData;
-				ZSTDDecode(qualityCompData, qualityCharData);
+					std::vector<char> qualityCompData;
+					if (writeMode == "json" || writeMode == "yaml")
+					{
+						Base64Decode(values[n], qualityCompData);
+					}
+					if (writeMode == "binary")
+					{
+						qualityCompData.assign(values[n].begin(), values[n].end());
+					}
 
-				std::vector<uint32_t> qualityEFCode;
-				for (int i = 0; i < qualityCharData.size() / 4; ++i)
-				{
-					for (int j = 0; j < 4; ++j)
+					if (genoFqzQuality)
 					{
-						char2uint32.Char[j] = qualityCharData[i * 4 + j];
+						if (!QualityCodec::Decode((const unsigned char*)qualityCompData.data(), qualityCompData.size(),
+							std::string(qKey.begin(), qKey.end()), readLen, (size_t)readLen * batchSize, qualityStr))
+						{
+							std::cout << "Error in decode quality scores!" << std::endl;
+							exit(1);
+						}
+						continue;
 					}
-					qualityEFCode.push_back(char2uint32.UInt32);
-				}
 
-				std::vector<uint32_t> qualityAccumulateArr;
-				EliasFanoDecode32(qualityEFCode, qualityAccumulateArr);
+					std::vector<char> qualityCharData;
+					ZSTDDecode(qualityCompData, qualityCharData);
 
-				qualityArr.resize(qualityAccumulateArr.size());
-				qualityArr[0] = qualityAccumulateArr[0];
+					std::vector<uint32_t> qualityAccumulateArr;
+					DecodeIntegers<uint32_t>(qualityCharData, qualityAccumulateArr);
 
-				for (int i = 1; i < qualityAccumulateArr.size(); ++i)
-				{
-					qualityArr[i] = qualityAccumulateArr[i] - qualityAccumulateArr[i - 1];
-				}
+					qualityArr.resize(qualityAccumulateArr.size());
+					qualityArr[0] = qualityAccumulateArr[0];
 
-			}
-		}
+					for (int i = 1; i < qualityAccumulateArr.size(); ++i)
+					{
+						qualityArr[i] = qualityAccumulateArr[i] - qualityAccumulateArr[i - 1];
+					}
 
-	}
+				}
+			}
 
-	EntryData entry;
+		}
 
-	std::string line = "";
-	for (int i = 0; i < batchSize; ++i)
-	{
-		line = "";
-		int c = 0;
-		for (int j = 0; j < idKeyList.size(); ++j)
+		// the tokens of every identifier, "\n" columns taken from the other mate
+		for (int i = 0; i < batchSize; ++i)
 		{
-			if (idKeyList[j].size() == 1)
+			int c = 0;
+			std::vector<std::string> tokens;
+			for (int j = 0; j < idKeyList.size(); ++j)
 			{
-				if (idKeyList[j][0] == "\t")
+				if (idKeyList[j].size() == 1)
 				{
-					if (line.back() == ':') line.pop_back();
-					line += " ";
+					if (idKeyList[j][0] == "\n" && shareTokens != NULL)
+					{
+						tokens.push_back((*shareTokens)[i][j]);
+					}
+					else if (idKeyList[j][0] == "?")
+					{
+						tokens.push_back(std::to_string(identifierValue[c * batchSize + i]));
+						++c;
+					}
+					else
+					{
+						tokens.push_back(idKeyList[j][0]);
+					}
 				}
-				else if (idKeyList[j][0] == "?")
+				else
 				{
-					line += std::to_string(identifierValue[c * batchSize + i]) + ":";
+					int k = identifierValue[c * batchSize + i];
+					tokens.push_back(idKeyList[j][k]);
 					++c;
 				}
+			}
+
+			std::string line = "";
+			for (int j = 0; j < tokens.size(); ++j)
+			{
+				if (tokens[j] == "\t")
+				{
+					if (line.back() == ':') line.pop_back();
+					line += " ";
+				}
 				else
 				{
-					line += idKeyList[j][0] + ":";
+					line += tokens[j] + ":";
 				}
 			}
-			else
-			{
-				int k = identifierValue[c * batchSize + i];
-				line += idKeyList[j][k] + ":";
-				++c;
-			}
-		}
-		if (line.back() == ':') line.pop_back();
+			if (line.back() == ':') line.pop_back();
 
-		entry.strTypeKey.push_back("identifier");
-		entry.strTypeValue.push_back(line);
-	}
-
-	for (int i = 0; i < NBasePos.size(); ++i)
-	{
-		baseSequence[NBasePos[i]] = 'N';
-	}
+			readTokens.push_back(tokens);
 
-	for (int i = 0; i < batchSize; ++i)
-	{
-		std::string seq(baseSequence, i * genoReadLen, genoReadLen);
-		
-		entry.strTypeKey.push_back("sequence");
-		entry.strTypeValue.push_back(seq);
-	}
+			entry.strTypeKey.push_back(entryKeys[0]);
+			entry.strTypeValue.push_back(line);
+		}
 
-	if (qKey.size() > 1)
-	{
-		std::string qualityStr = "";
-		for (int i = 0; i < qualityArr.size() / 2; ++i)
+		for (int i = 0; i < NBasePos.size(); ++i)
 		{
-			for (int j = 0; j < qualityArr[2 * i + 1]; ++j)
-			{
-				qualityStr += qKey[qualityArr[2 * i]];
-			}
+			baseSequence[NBasePos[i]] = 'N';
 		}
 
 		for (int i = 0; i < batchSize; ++i)
 		{
-			std::string quality(qualityStr, i * genoReadLen, genoReadLen);
+			std::string seq(baseSequence, i * readLen, readLen);
 			
-			entry.strTypeKey.push_back("quality");
-			entry.strTypeValue.push_back(quality);
+			entry.strTypeKey.push_back(entryKeys[1]);
+			entry.strTypeValue.push_back(seq);
 		}
-	}
-	else
-	{
-		for (int i = 0; i < batchSize; ++i)
+
+		if (qKey.size() > 1)
 		{
-			std::string quality(genoReadLen, qKey[0]);
+			for (int i = 0; i < qualityArr.size() / 2; ++i)
+			{
+				for (int j = 0; j < qualityArr[2 * i + 1]; ++j)
+				{
+					qualityStr += qKey[qualityArr[2 * i]];
+				}
+			}
 
-			entry.strTypeKey.push_back("quality");
-			entry.strTypeValue.push_back(quality);
+			for (int i = 0; i < batchSize; ++i)
+			{
+				std::string quality(qualityStr, i * readLen, readLen);
+				
+				entry.strTypeKey.push_back(entryKeys[2]);
+				entry.strTypeValue.push_back(quality);
+			}
 		}
+		else
+		{
+			for (int i = 0; i < batchSize; ++i)
+			{
+				std::string quality(readLen, qKey[0]);
+
+				entry.strTypeKey.push_back(entryKeys[2]);
+				entry.strTypeValue.push_back(quality);
+			}
+		}
+	};
+
+	std::vector< std::vector<std::string> > readTokens;
+	decodeReads(valueList, genoReadLen, { "identifier", "sequence", "quality" }, readTokens, NULL);
+
+	if (mateValueList.size() > 0)
+	{
+		std::vector< std::vector<std::string> > mateTokens;
+		decodeReads(mateValueList, genoMateReadLen, { "mateIdentifier", "mateSequence", "mateQuality" }, mateTokens, &readTokens);
 	}
 
 	return entry;
@@ -5,7 +5,197 @@
 
 int OMGParser::GetEntryNumber()
 {
-	return entryTable.size();
+	return indexEntryCount;
+}
+
+std::vector<std::string> OMGParser::GetColumnNames()
+{
+	std::vector<std::string> names;
+	for (uint32_t k = 0; k < columnCount; ++k)
+	{
+		names.push_back(columnInfo[k].name);
+	}
+
+	return names;
+}
+
+// Entries whose column value lies in [low, high], answered from the footer
+// columns before any entry is read.
+std::vector<int> OMGParser::FilterEntries(std::string column, double low, double high)
+{
+	std::vector<int> entryIds(GetEntryNumber());
+	for (int i = 0; i < entryIds.size(); ++i)
+	{
+		entryIds[i] = i;
+	}
+
+	return FilterEntries(column, low, high, entryIds);
+}
+
+// Keeps those of entryIds that match, so conditions can be chained.
+std::vector<int> OMGParser::FilterEntries(std::string column, double low, double high, const std::vector<int>& entryIds)
+{
+	uint32_t k = 0;
+	while (k < columnCount && column != columnInfo[k].name) ++k;
+
+	if (k == columnCount)
+	{
+		std::cout << "[ERROR] " << omgFileName << " has no column \"" << column << "\"!\n";
+		exit(1);
+	}
+
+	const char* values = columnData + k * ((indexEntryCount * sizeof(uint32_t) + 7) / 8 * 8);
+	std::vector<int> selected;
+
+	if (columnInfo[k].type == OMG_COLUMN_FLOAT32)
+	{
+		const float* x = (const float*)values;
+		for (int i = 0; i < entryIds.size(); ++i)
+		{
+			if (x[entryIds[i]] >= low && x[entryIds[i]] <= high) selected.push_back(entryIds[i]);
+		}
+	}
+	else
+	{
+		const uint32_t* x = (const uint32_t*)values;
+		for (int i = 0; i < entryIds.size(); ++i)
+		{
+			if (x[entryIds[i]] >= low && x[entryIds[i]] <= high) selected.push_back(entryIds[i]);
+		}
+	}
+
+	return selected;
+}
+
+// Scrubs a file written with checksums: the index, then every block against
+// its CRC32C on nThreads threads, without decoding anything. Each thread
+// checks one stretch of the file in file order, with its own handle in disk
+// mode. Prints the corrupted blocks and returns whether all of them passed;
+// a file that cannot be checked, e.g. json or yaml, does not pass.
+bool OMGParser::VerifyFile(int nThreads)
+{
+	if (!blockChecksum)
+	{
+		std::cout << "[ERROR] " << omgFileName << " was written without checksums, it cannot be verified!\n";
+		return false;
+	}
+
+	if (!CheckIndex())
+	{
+		std::cout << "[ERROR] The index of " << omgFileName << " fails its checksum, the file is corrupted!\n";
+		return false;
+	}
+
+	std::vector<uint64_t> order(blockCount);
+	for (uint64_t i = 0; i < blockCount; ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](uint64_t x, uint64_t y)
+		{
+			return blockIndex[2 * x] < blockIndex[2 * y];
+		});
+
+	if (nThreads < 1) nThreads = 1;
+
+	std::vector<std::thread> verifiers(nThreads);
+	std::vector< std::vector<uint64_t> > corrupted(nThreads);
+	std::atomic<bool> unreadable(false);
+
+	for (int n = 0; n < nThreads; ++n)
+	{
+		verifiers[n] = std::thread([&](int n, uint64_t begin, uint64_t stop)
+			{
+				FILE* filePtr = NULL;
+				if (readMode == "disk")
+				{
+					filePtr = fopen(omgFileName.c_str(), "rb");
+					if (!filePtr)
+					{
+						unreadable = true;
+						return;
+					}
+					setvbuf(filePtr, NULL, _IOFBF, 4 * 1024 * 1024);
+				}
+
+				std::vector<char> buffer;
+				uint64_t filePos = UINT64_MAX;
+				fpos_t ptrPos;
+
+				for (uint64_t i = begin; i < stop; ++i)
+				{
+					uint64_t block = order[i];
+					uint64_t offset = blockIndex[2 * block];
+					uint64_t size = blockIndex[2 * block + 1];
+
+					if (offset + size > omgFileVolume)
+					{
+						corrupted[n].push_back(block);
+						continue;
+					}
+
+					const char* data = fullFileBuffer + offset;
+					if (filePtr)
+					{
+						if (filePos != offset)
+						{
+#ifdef _WIN32
+							ptrPos = offset;
+#endif // !_WIN32
+
+#ifdef __linux__
+							ptrPos.__pos = offset;
+#endif // __linux__
+
+							fsetpos(filePtr, &ptrPos);
+						}
+
+						buffer.resize(size);
+						size_t readLen = fread(buffer.data(), sizeof(char), size, filePtr);
+						filePos = offset + readLen;
+						data = buffer.data();
+
+						if (readLen != size)
+						{
+							corrupted[n].push_back(block);
+							continue;
+						}
+					}
+
+					if (CRC32C::Compute(data, size) != blockChecksum[block])
+					{
+						corrupted[n].push_back(block);
+					}
+				}
+
+				if (filePtr) fclose(filePtr);
+			}, n, blockCount * n / nThreads, blockCount * (n + 1) / nThreads);
+	}
+
+	uint64_t corruptedCount = 0;
+	for (int n = 0; n < nThreads; ++n)
+	{
+		verifiers[n].join();
+
+		for (int i = 0; i < corrupted[n].size(); ++i)
+		{
+			uint64_t block = corrupted[n][i];
+			std::cout << "[ERROR] Block " << block << " at offset " << blockIndex[2 * block]
+				<< " (" << blockIndex[2 * block + 1] << " bytes) fails its checksum!\n";
+		}
+		corruptedCount += corrupted[n].size();
+	}
+
+	if (unreadable)
+	{
+		std::cout << "[ERROR] Cannot open " << omgFileName << " to verify it!\n";
+		return false;
+	}
+
+	std::cout << "[INFO] Verified " << blockCount << " blocks of " << omgFileName
+		<< ", " << corruptedCount << " corrupted.\n";
+
+	return corruptedCount == 0;
 }
 
 OMGParser::EntryData OMGParser::GetOMGFileEntry(int entryId)
@@ -24,6 +214,17 @@ OMGParser::EntryData OMGParser::GetOMGFileEntry(int entryId)
 	}
 }
 
+OMGParser::EntryData OMGParser::GetOMGFileEntryMzRange(int entryId, float mzLow, float mzHigh)
+{
+	if (this->omics != "Proteomics")
+	{
+		std::cout << "[ERROR] m/z window query only supports proteomics OMG files!\n";
+		exit(1);
+	}
+
+	return ProteomicsEntry(entryId, mzLow, mzHigh);
+}
+
 OMGParser::EntryData OMGParser::GetOMGFileBasicInfo()
 {
 	EntryData entry;
@@ -5,6 +5,7 @@
 
 #include "namespace.h"
 #include "utility.h"
+#include "eliasfano.h"
 #include "interface.h"
 
 #include "omgParser.h"
@@ -17,6 +18,9 @@ int main(int argc, char* argv[])
 	int nThreads = 0;
 	std::string readMode = "";
 	std::string omgFileName = "";
+	std::string filter = "";
+	bool verify = false;
+	bool verifyReads = false;
 
 	for (int i = 1; i < argc; ++i)
 	{
@@ -42,14 +46,64 @@ int main(int argc, char* argv[])
 				if (omgFileName[j] == '\\') omgFileName[j] = '/';
 			}
 		}
+		if (line.find("--filter=") != line.npos)
+		{
+			int pos = line.find("--filter=");
+			filter = line.substr(pos + 9);
+		}
+		if (line.find("--verify=") != line.npos)
+		{
+			int pos = line.find("--verify=");
+			verify = line.substr(pos + 9) == "1";
+		}
+		if (line.find("--verify_reads=") != line.npos)
+		{
+			int pos = line.find("--verify_reads=");
+			verifyReads = line.substr(pos + 15) == "1";
+		}
 
 	}
 
 	clock_t startTime = clock();
 
-	OMGParser parser(omgFileName, readMode);
+	OMGParser parser(omgFileName, readMode, verifyReads);
+
+	if (verify)
+	{
+		bool passed = parser.VerifyFile(nThreads);
+
+		std::cout << "nThread: " << nThreads <<
+			" elapse time: " << (double)(clock() - startTime) / CLOCKS_PER_SEC << "\n";
+
+		return passed ? 0 : 1;
+	}
+
+	// --filter=column:low:high;column:low:high selects entries by the footer columns
+	std::vector<int> entryIds(parser.GetEntryNumber());
+	for (int i = 0; i < entryIds.size(); ++i)
+	{
+		entryIds[i] = i;
+	}
+
+	while (filter.length() > 0)
+	{
+		std::string condition = filter.substr(0, filter.find(';'));
+		filter = filter.find(';') == filter.npos ? "" : filter.substr(filter.find(';') + 1);
+
+		int first = condition.find(':');
+		int second = condition.find(':', first + 1);
+		if (first == condition.npos || second == condition.npos)
+		{
+			std::cout << "[ERROR] Please write filters as column:low:high!\n";
+			exit(1);
+		}
+
+		entryIds = parser.FilterEntries(condition.substr(0, first),
+			std::stod(condition.substr(first + 1, second - first - 1)),
+			std::stod(condition.substr(second + 1)), entryIds);
+	}
 
-	int nEntrys = parser.GetEntryNumber();
+	int nEntrys = entryIds.size();
 
 	int nReaders = nEntrys / nThreads;
 
@@ -68,7 +122,7 @@ int main(int argc, char* argv[])
 			{
 				for (int i = begin; i < stop; ++i)
 				{
-					OMGParser::EntryData entry = parser.GetOMGFileEntry(i);
+					OMGParser::EntryData entry = parser.GetOMGFileEntry(entryIds[i]);
 				}
 			}, st, ed);
 
@@ -2,6 +2,7 @@
 #define METABOLOMICS_H
 
 #include "namespace.h"
+#include "codec.h"
 
 OMGParser::EntryData OMGParser::MetabolomicsEntry(int entryId)
 {
@@ -9,24 +10,7 @@ OMGParser::EntryData OMGParser::MetabolomicsEntry(int entryId)
 	Char2UInt32 char2uint32;
 	Char2UInt64 char2uint64;
 
-	uint64_t startPos = entryTable[entryId][0];
-	uint64_t byteCount = entryTable[entryId][1];
-
-	char* entryBuff = (char*)malloc(byteCount * sizeof(char));
-	if (readMode == "disk")
-	{
-		filePtrPos = startPos;
-		fsetpos(omgFilePtr, &filePtrPos);
-
-		size_t readSize = fread(entryBuff, sizeof(char), byteCount, omgFilePtr);
-	}
-	else if (readMode == "memory")
-	{
-		memcpy(entryBuff, fullFileBuffer + startPos, byteCount);
-	}
-
-	std::string entryString(entryBuff, entryBuff + byteCount);
-	free(entryBuff);
+	std::string entryString = ReadEntry(entryId);
 
 	EntryData entry;
 	float minIntensity = 0.0f;
@@ -47,7 +31,7 @@ OMGParser::EntryData OMGParser::MetabolomicsEntry(int entryId)
 		if (loadEntry != entryId)
 		{
 			std::cout << "[ERROR] Wrong in comparing load entryId and input entryId!" << std::endl;
-			exit(0);
+			exit(1);
 		}
 
 		for (int n = 0; n < keyList.size(); ++n)
@@ -128,18 +112,8 @@ OMGParser::EntryData OMGParser::MetabolomicsEntry(int entryId)
 		std::vector<char> mzDecompData;
 		ZSTDDecode(mzCompData, mzDecompData);
 
-		std::vector<uint32_t> mzEFCode;
-		for (int j = 0; j < mzDecompData.size() / 4; ++j)
-		{
-			for (int k = 0; k < 4; ++k)
-			{
-				char2uint32.Char[k] = mzDecompData[j * 4 + k];
-			}
-			mzEFCode.push_back(char2uint32.UInt32);
-		}
-
 		std::vector<uint32_t> mzArrInt;
-		EliasFanoDecode32(mzEFCode, mzArrInt);
+		DecodeIntegers<uint32_t>(mzDecompData, mzArrInt);
 
 		std::vector<float> mzArrFloat(mzArrInt.size());
 		for (int j = 0; j < mzArrInt.size(); ++j)
@@ -154,18 +128,8 @@ OMGParser::EntryData OMGParser::MetabolomicsEntry(int entryId)
 	std::vector<char> intDecompData;
 	ZSTDDecode(intCompData, intDecompData);
 
-	std::vector<uint32_t> intEFCode;
-	for (int j = 0; j < intDecompData.size() / 4; ++j)
-	{
-		for (int k = 0; k < 4; ++k)
-		{
-			char2uint32.Char[k] = intDecompData[j * 4 + k];
-		}
-		intEFCode.push_back(char2uint32.UInt32);
-	}
-
 	std::vector<uint32_t> intArrInt;
-	EliasFanoDecode32(intEFCode, intArrInt);
+	DecodeIntegers<uint32_t>(intDecompData, intArrInt);
 
 	std::vector<float> intArrFloat(intArrInt.size());
 	intArrFloat[0] = powf((float)intArrInt[0], 2.0f) * 1e-4 + minIntensity;
@@ -7,13 +7,26 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <memory>
+#include <atomic>
 #include <string.h>
 #include <iostream>
 #include <algorithm>
 #include <unordered_map>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #include "zstd.h"
 #include "Base64.h"
+#include "eliasfano.h"
+#include "omgfooter.h"
 
 class OMGParser
 {
@@ -31,19 +44,34 @@ public:
 	~OMGParser() 
 	{
 		fclose(omgFilePtr);
-		if (writeMode == "memory")
+		if (readMode == "memory")
 		{
 			free(fullFileBuffer); 
 			fullFileBuffer = NULL;
 		}
+		if (readMode == "mmap")
+		{
+			UnmapFile();
+		}
+		for (auto it = zstdDicts.begin(); it != zstdDicts.end(); ++it)
+		{
+			ZSTD_freeDDict(it->second);
+		}
 	}
-	OMGParser(std::string omgFileName, std::string readMode);
+	OMGParser(std::string omgFileName, std::string readMode, bool verifyReads = false);
 
 	EntryData GetOMGFileBasicInfo();
 	EntryData GetOMGFileEntry(int entryId);
+	EntryData GetOMGFileEntryMzRange(int entryId, float mzLow, float mzHigh);
 
 	int GetEntryNumber();
 
+	std::vector<std::string> GetColumnNames();
+	std::vector<int> FilterEntries(std::string column, double low, double high);
+	std::vector<int> FilterEntries(std::string column, double low, double high, const std::vector<int>& entryIds);
+
+	bool VerifyFile(int nThreads);
+
 private:
 
 	FILE* omgFilePtr;
@@ -51,6 +79,7 @@ private:
 
 	fpos_t filePtrPos;
 	char* fullFileBuffer;
+	int64_t omgFileVolume = 0;
 
 	std::string omics = "";
 	std::string parentFormat = "";
@@ -59,14 +88,48 @@ private:
 	std::string writeMode = "";
 	std::string basicInfo = "";
 
+	// integer streams start with a codec tag (see codec.h)
+	bool codecTagged = false;
+
+	// zstd dictionaries from BasicInfo, keyed by dictionary ID
+	std::unordered_map<unsigned, ZSTD_DDict*> zstdDicts;
+
 	double mzPrecision = 1e3;
 	int fastqBatchSize = 512;
 
 	uint32_t entryCount;
 	EntryData basicEntry;
 	uint32_t genoReadLen;
-	std::vector<uint32_t> offsetVector;
-	std::vector< std::vector<uint64_t> > entryTable;
+
+	// --paired files hold the R2 mate of every read after it
+	bool genoPaired = false;
+	uint32_t genoMateReadLen = 0;
+
+	// --quality_codec=fqz files code the quality scores with QualityCodec
+	bool genoFqzQuality = false;
+
+	// footer index: { offset, size } of every block, a block being one entry
+	// or, in superblock files, one superblock whose first entry id is kept in
+	// blockFirstEntry. Both point into the file buffer or into indexBuffer.
+	uint64_t indexEntryCount = 0;
+	uint64_t blockCount = 0;
+	const uint64_t* blockIndex = NULL;
+	const uint64_t* blockFirstEntry = NULL;
+	std::vector<uint64_t> indexBuffer;
+
+	// footer columns of binary files, entryCount values each (see omgfooter.h)
+	uint32_t columnCount = 0;
+	const OMGColumn* columnInfo = NULL;
+	const char* columnData = NULL;
+
+	// CRC32C of every block and of the index, in files written with checksums.
+	// verifyReads checks each block as it is read.
+	OMGFooter omgFooter;
+	const uint32_t* blockChecksum = NULL;
+	bool verifyReads = false;
+
+	bool superblocked = false;
+	uint64_t parserSerial = 0;
 
 	union Char2Float
 	{
@@ -93,16 +156,32 @@ private:
 	};
 
 	EntryData GenomicsEntry(int entryId);
-	EntryData ProteomicsEntry(int entryId);
+	EntryData ProteomicsEntry(int entryId, float mzLow = -1.0f, float mzHigh = -1.0f);
 	EntryData MetabolomicsEntry(int entryId);
 
 	void PaserTextData(std::string& text, std::string& title,
 		std::vector<std::string>& keyList, std::vector<std::string>& valueList);
 
+	void ReadBinaryFooter(OMGFooter& footer);
+	uint64_t ReadTextFooter(char* footerTail);
+
+	char* MapFile();
+	void UnmapFile();
+
+	std::string ReadEntry(int entryId);
+	bool CheckIndex();
+	void CheckBlock(uint64_t block, const char* data);
+	void ReadFileBytes(uint64_t startPos, uint64_t byteCount, char* buffer);
+
 	void Base64Decode(std::string& input, std::vector<char>& output);
 	void ZSTDDecode(std::vector<char>& input, std::vector<char>& output);
-	void EliasFanoDecode32(std::vector<uint32_t>& EFCode, std::vector<uint32_t>& x);
-	void EliasFanoDecode64(std::vector<uint64_t>& EFCode, std::vector<uint64_t>& x);
+	void ZSTDDecodeFrame(std::vector<char>& input, std::vector<char>& output);
+
+	template <typename WordT, typename ValueT>
+	void DecodeIntegers(std::vector<char>& input, std::vector<ValueT>& output);
+
+	template <typename WordT>
+	Span<const WordT> GetEFWords(std::vector<char>& input, std::vector<WordT>& scratch);
 };
 
 #endif // !NAMESPACE_H
@@ -3,29 +3,30 @@
 
 #include "namespace.h"
 
-OMGParser::OMGParser(std::string omgFileName, std::string readMode)
+OMGParser::OMGParser(std::string omgFileName, std::string readMode, bool verifyReads)
 {
-	if (readMode != "disk" && readMode != "memory")
+	if (readMode != "disk" && readMode != "memory" && readMode != "mmap")
 	{
-		std::cout << "[ERROR] Please select the read mode as \"disk\" or \"memory\"!\n";
-		exit(0);
+		std::cout << "[ERROR] Please select the read mode as \"disk\", \"memory\" or \"mmap\"!\n";
+		exit(1);
 	}
 
 	this->readMode = readMode;
 	this->omgFileName = omgFileName;
+	this->verifyReads = verifyReads;
 
 	omgFilePtr = fopen(omgFileName.c_str(), "rb");
 	if (!omgFilePtr)
 	{
 		std::cout << "[ERROR] Cannot open " << omgFileName << ".\n"
 			<< "[ERROR] Please check your file or directory!\n";
-		exit(0);
+		exit(1);
 	}
 
 	struct __stat64 fileStat;
 
 	_stat64(omgFileName.c_str(), &fileStat);
-	int64_t omgFileVolume = fileStat.st_size; // Bytes
+	omgFileVolume = fileStat.st_size; // Bytes
 
 	if (readMode == "memory")
 	{
@@ -35,135 +36,50 @@ OMGParser::OMGParser(std::string omgFileName, std::string readMode)
 		if (fullSize != omgFileVolume)
 		{
 			std::cout << "[ERROR] Something was wrong in fread omgfile!\n";
-			exit(0);
+			exit(1);
 		}
 	}
-
-	char* offsetLenArr = (char*)malloc(64 * sizeof(char));
-
-	if (readMode == "disk")
+	else if (readMode == "mmap")
 	{
-#ifdef _WIN32
-		filePtrPos = omgFileVolume - 64;
-#endif // !_WIN32
-
-#ifdef __linux__
-		filePtrPos.__pos = omgFileVolume - 64;
-#endif // __linux__
-
-		fsetpos(omgFilePtr, &filePtrPos);
-		size_t size = fread(offsetLenArr, sizeof(char), 64, omgFilePtr);
-	}
-	else if (readMode == "memory")
-	{
-		memcpy(offsetLenArr, fullFileBuffer + omgFileVolume - 64, 64);
-	}
-
-	bool flag = false;
-	std::string lenStr = "";
-	for (int i = 0; i < 64; ++i)
-	{
-		if (flag && offsetLenArr[i] == ' ')
-		{
-			break;
-		}
-
-		if (flag)
-		{
-			if (offsetLenArr[i] == '\"') continue;
-			lenStr += offsetLenArr[i];
-		}
-
-		if (offsetLenArr[i] == ':')
-		{
-			flag = true;
-			continue;
-		}
+		fullFileBuffer = MapFile();
 	}
 
-	free(offsetLenArr);
+	char* footerTail = (char*)malloc(64 * sizeof(char));
+	ReadFileBytes(omgFileVolume - 64, 64, footerTail);
 
-	int offsetLen = std::stoi(lenStr);
+	uint64_t headerOffset = 0;
+	uint64_t headerSize = 0;
 
-	char* offsetVecChar = (char*)malloc(offsetLen * sizeof(char));
-
-	if (readMode == "disk")
+	if (IsOMGFooter(footerTail))
 	{
-#ifdef _WIN32
-		filePtrPos = omgFileVolume - offsetLen - 64;
-#endif // !_WIN32
-
-#ifdef __linux__
-		filePtrPos.__pos = omgFileVolume - offsetLen - 64;
-#endif // __linux__
+		OMGFooter footer;
+		memcpy(&footer, footerTail, sizeof(OMGFooter));
 
-		fsetpos(omgFilePtr, &filePtrPos);
-		size_t size = fread(offsetVecChar, sizeof(char), offsetLen, omgFilePtr);
+		ReadBinaryFooter(footer);
+		headerOffset = footer.headerOffset;
+		headerSize = footer.headerSize;
 	}
-	else if (readMode == "memory")
+	else
 	{
-		memcpy(offsetVecChar, fullFileBuffer + omgFileVolume - offsetLen - 64, offsetLen);
+		headerSize = ReadTextFooter(footerTail);
 	}
+	free(footerTail);
 
-	flag = false;
-	std::string offsetBase64Code = "";
-	for (int i = 0; i < offsetLen; ++i)
+	if (verifyReads && blockChecksum && !CheckIndex())
 	{
-		if (offsetVecChar[i] == '\n') break;
-
-		if (flag)
-		{
-			if (offsetVecChar[i] == '\"' || offsetVecChar[i] == ' ') continue;
-			offsetBase64Code += offsetVecChar[i];
-		}
-
-		if (offsetVecChar[i] == ':')
-		{
-			flag = true;
-			continue;
-		}
+		std::cout << "[ERROR] The index of " << omgFileName << " fails its checksum, the file is corrupted!\n";
+		exit(1);
 	}
-	free(offsetVecChar);
-
-	size_t size = Base64::textToBinarySize(offsetBase64Code.length());
-	unsigned char* result = (unsigned char*)malloc(size * sizeof(unsigned char));
-	Base64::textToBinary(offsetBase64Code.c_str(), offsetBase64Code.length(), result);
 
-	Char2UInt32 char2uint32;
-
-	for (int i = 0; i < size / 4; ++i)
+	if (superblocked)
 	{
-		for (int j = 0; j < 4; ++j)
-		{
-			char2uint32.Char[j] = result[i * 4 + j];
-		}
-		offsetVector.push_back(char2uint32.UInt32);
+		static std::atomic<uint64_t> parserCount(0);
+		parserSerial = ++parserCount;
 	}
-	free(result);
-
-	uint64_t startPos = offsetVector[0];
 
-	for (int i = 1; i < offsetVector.size(); ++i)
-	{
-		std::vector<uint64_t> tmp = { startPos, offsetVector[i] };
-		entryTable.push_back(tmp);
-		startPos += offsetVector[i];
-	}
-
-	uint32_t basicInfoLen = offsetVector[0];
+	uint32_t basicInfoLen = headerSize;
 	char* basicInfoBuf = (char*)malloc(basicInfoLen * sizeof(char));
-
-	if (readMode == "disk")
-	{
-		filePtrPos = 0;
-		fsetpos(omgFilePtr, &filePtrPos);
-
-		size_t readSize = fread(basicInfoBuf, sizeof(char), basicInfoLen, omgFilePtr);
-	}
-	else if (readMode == "memory")
-	{
-		memcpy(basicInfoBuf, fullFileBuffer, basicInfoLen);
-	}
+	ReadFileBytes(headerOffset, basicInfoLen, basicInfoBuf);
 
 	for (int i = 0; i < basicInfoLen; ++i)
 	{
@@ -192,6 +108,27 @@ OMGParser::OMGParser(std::string omgFileName, std::string readMode)
 		{
 			this->parentFormat = basicEntry.strTypeValue[i];
 		}
+		if (basicEntry.strTypeKey[i] == "codecTag")
+		{
+			this->codecTagged = basicEntry.strTypeValue[i] == "1";
+		}
+		if (basicEntry.strTypeKey[i].compare(0, 9, "zstdDict_") == 0)
+		{
+			std::vector<char> dictContent;
+			Base64Decode(basicEntry.strTypeValue[i], dictContent);
+
+			ZSTD_DDict* ddict = ZSTD_createDDict(dictContent.data(), dictContent.size());
+			unsigned dictID = ZSTD_getDictID_fromDDict(ddict);
+
+			// frames name their dictionary by ID only, two with one ID cannot be told apart
+			if (this->zstdDicts.count(dictID) > 0)
+			{
+				ZSTD_freeDDict(ddict);
+				std::cout << "[ERROR] Two zstd dictionaries of " << omgFileName << " share the ID " << dictID << ", the file is corrupted!\n";
+				exit(1);
+			}
+			this->zstdDicts[dictID] = ddict;
+		}
 	}
 
 	if (this->omics == "Genomics")
@@ -206,6 +143,18 @@ OMGParser::OMGParser(std::string omgFileName, std::string readMode)
 			{
 				this->genoReadLen = std::stoi(basicEntry.strTypeValue[i]);
 			}
+			if (basicEntry.strTypeKey[i] == "pairedEnd")
+			{
+				this->genoPaired = basicEntry.strTypeValue[i] == "1";
+			}
+			if (basicEntry.strTypeKey[i] == "mateReadLength")
+			{
+				this->genoMateReadLen = std::stoi(basicEntry.strTypeValue[i]);
+			}
+			if (basicEntry.strTypeKey[i] == "qualityCodec")
+			{
+				this->genoFqzQuality = basicEntry.strTypeValue[i] == "fqz";
+			}
 		}
 	}
 	else
@@ -221,5 +170,150 @@ OMGParser::OMGParser(std::string omgFileName, std::string readMode)
 	}
 }
 
+// Indexes the binary footer of omgfooter.h. Memory and mmap modes point
+// straight into the file, disk mode reads the tables with one fread.
+void OMGParser::ReadBinaryFooter(OMGFooter& footer)
+{
+	if (footer.version > OMG_FOOTER_VERSION)
+	{
+		std::cout << "[ERROR] " << omgFileName << " was written by a newer version of DearOMG!\n";
+		exit(1);
+	}
+
+	omgFooter = footer;
+	superblocked = (footer.flags & OMG_FOOTER_SUPERBLOCKS) != 0;
+	indexEntryCount = footer.entryCount;
+	blockCount = footer.blockCount;
+	columnCount = footer.columnCount;
+
+	const char* table = NULL;
+	if (readMode == "disk")
+	{
+		uint64_t tableSize = OMGFooterTableSize(blockCount, footer.flags) +
+			OMGFooterColumnsSize(indexEntryCount, columnCount);
+		indexBuffer.resize(tableSize / sizeof(uint64_t));
+		ReadFileBytes(footer.tableOffset, tableSize, (char*)indexBuffer.data());
+
+		table = (const char*)indexBuffer.data();
+	}
+	else
+	{
+		table = fullFileBuffer + footer.tableOffset;
+	}
+
+	blockIndex = (const uint64_t*)table;
+	if (superblocked)
+	{
+		blockFirstEntry = blockIndex + 2 * blockCount;
+	}
+
+	if (footer.flags & OMG_FOOTER_CHECKSUMS)
+	{
+		const char* levels = (const char*)(blockIndex + (superblocked ? 3 : 2) * blockCount);
+		blockChecksum = (const uint32_t*)(levels + (blockCount + 7) / 8 * 8);
+	}
+
+	columnInfo = (const OMGColumn*)(table + OMGFooterTableSize(blockCount, footer.flags));
+	columnData = (const char*)(columnInfo + columnCount);
+}
+
+// Decodes the offsetArr line of json and yaml files (and of binary files
+// written before the binary footer) into indexBuffer. Returns the size of
+// BasicInfo.
+uint64_t OMGParser::ReadTextFooter(char* footerTail)
+{
+	bool flag = false;
+	std::string lenStr = "";
+	for (int i = 0; i < 64; ++i)
+	{
+		if (flag && footerTail[i] == ' ')
+		{
+			break;
+		}
+
+		if (flag)
+		{
+			if (footerTail[i] == '\"') continue;
+			lenStr += footerTail[i];
+		}
+
+		if (footerTail[i] == ':')
+		{
+			flag = true;
+			continue;
+		}
+	}
+
+	int offsetLen = std::stoi(lenStr);
+
+	char* offsetVecChar = (char*)malloc(offsetLen * sizeof(char));
+	ReadFileBytes(omgFileVolume - offsetLen - 64, offsetLen, offsetVecChar);
+
+	flag = false;
+	std::string key = "";
+	std::string value = "";
+	std::string offsetBase64Code = "";
+	for (int i = 0; i < offsetLen; ++i)
+	{
+		if (offsetVecChar[i] == '\n')
+		{
+			if (key == "offsetArr") offsetBase64Code = value;
+
+			key = "";
+			value = "";
+			flag = false;
+			continue;
+		}
+
+		if (offsetVecChar[i] == '\"' || offsetVecChar[i] == ' ') continue;
+
+		if (offsetVecChar[i] == ':' && !flag)
+		{
+			flag = true;
+			continue;
+		}
+
+		if (flag)
+		{
+			value += offsetVecChar[i];
+		}
+		else
+		{
+			key += offsetVecChar[i];
+		}
+	}
+	free(offsetVecChar);
+
+	std::vector<char> offsetChar;
+	Base64Decode(offsetBase64Code, offsetChar);
+
+	Char2UInt32 char2uint32;
+	std::vector<uint32_t> offsetVector;
+
+	for (int i = 0; i < offsetChar.size() / 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			char2uint32.Char[j] = offsetChar[i * 4 + j];
+		}
+		offsetVector.push_back(char2uint32.UInt32);
+	}
+
+	uint64_t startPos = offsetVector[0];
+
+	indexEntryCount = blockCount = offsetVector.size() - 1;
+	indexBuffer.resize(2 * blockCount);
+
+	for (int i = 1; i < offsetVector.size(); ++i)
+	{
+		indexBuffer[2 * (i - 1)] = startPos;
+		indexBuffer[2 * (i - 1) + 1] = offsetVector[i];
+		startPos += offsetVector[i];
+	}
+	blockIndex = indexBuffer.data();
+
+	return offsetVector[0];
+}
+
 
 #endif // !OMGPARSER_H
@@ -2,31 +2,15 @@
 #define PROTEOMICS_H
 
 #include "namespace.h"
+#include "codec.h"
 
-OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
+OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId, float mzLow, float mzHigh)
 {
 	Char2Float char2float;
 	Char2UInt32 char2uint32;
 	Char2UInt64 char2uint64;
 
-	uint64_t startPos = entryTable[entryId][0];
-	uint64_t byteCount = entryTable[entryId][1];
-
-	char* entryBuff = (char*)malloc(byteCount * sizeof(char));
-	if (readMode == "disk")
-	{
-		filePtrPos = startPos;
-		fsetpos(omgFilePtr, &filePtrPos);
-
-		size_t readSize = fread(entryBuff, sizeof(char), byteCount, omgFilePtr);
-	}
-	else if (readMode == "memory")
-	{
-		memcpy(entryBuff, fullFileBuffer + startPos, byteCount);
-	}
-
-	std::string entryString(entryBuff, entryBuff + byteCount);
-	free(entryBuff);
+	std::string entryString = ReadEntry(entryId);
 
 	EntryData entry;
 	std::vector<char> mzCompData;
@@ -47,7 +31,7 @@ OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
 		if (loadEntry != entryId)
 		{
 			std::cout << "[ERROR] Wrong in comparing load entryId and input entryId!" << std::endl;
-			exit(0);
+			exit(1);
 		}
 
 		for (int n = 0; n < keyList.size(); ++n)
@@ -128,19 +112,43 @@ OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
 	std::vector<char> mzDecompData;
 	ZSTDDecode(mzCompData, mzDecompData);
 
-	std::vector<uint32_t> mzEFCode;
-	for (int j = 0; j < mzDecompData.size() / 4; ++j)
+	// with an m/z window only the peaks inside it are decoded, located by NextGEQ.
+	// Streams stored with a non-EF codec are decoded whole and cut to the window.
+	bool inWindow = mzLow >= 0.0f && mzHigh >= mzLow;
+
+	uint64_t mzFirst = (uint64_t)std::ceil(mzLow * mzPrecision);
+	uint64_t mzLast = (uint64_t)std::floor(mzHigh * mzPrecision) + 1;
+
+	uint64_t rangeBegin = 0;
+	uint64_t rangeEnd = 0;
+
+	std::vector<uint32_t> mzScratch;
+	Span<const uint32_t> mzEFCode(NULL, 0);
+	if (inWindow) mzEFCode = GetEFWords(mzDecompData, mzScratch);
+
+	std::vector<uint32_t> mzArrInt;
+	if (mzEFCode.size > 0)
 	{
-		for (int k = 0; k < 4; ++k)
+		EliasFanoIndex<uint32_t> mzIndex(mzEFCode);
+
+		rangeBegin = mzIndex.NextGEQ(mzFirst);
+		rangeEnd = mzIndex.NextGEQ(mzLast);
+
+		mzIndex.Range(rangeBegin, rangeEnd, mzArrInt);
+	}
+	else
+	{
+		DecodeIntegers<uint32_t>(mzDecompData, mzArrInt);
+
+		if (inWindow)
 		{
-			char2uint32.Char[k] = mzDecompData[j * 4 + k];
+			rangeBegin = std::lower_bound(mzArrInt.begin(), mzArrInt.end(), mzFirst) - mzArrInt.begin();
+			rangeEnd = std::lower_bound(mzArrInt.begin(), mzArrInt.end(), mzLast) - mzArrInt.begin();
+
+			mzArrInt = std::vector<uint32_t>(mzArrInt.begin() + rangeBegin, mzArrInt.begin() + rangeEnd);
 		}
-		mzEFCode.push_back(char2uint32.UInt32);
 	}
 
-	std::vector<uint32_t> mzArrInt;
-	EliasFanoDecode32(mzEFCode, mzArrInt);
-
 	std::vector<float> mzArrFloat(mzArrInt.size());
 	for (int j = 0; j < mzArrInt.size(); ++j)
 	{
@@ -153,31 +161,42 @@ OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
 	std::vector<char> intDecompData;
 	ZSTDDecode(intCompData, intDecompData);
 
-	std::vector<uint64_t> intEFCode;
-	for (int j = 0; j < intDecompData.size() / 8; ++j)
+	uint64_t intPrev = 0;
+	std::vector<uint64_t> intScratch;
+	Span<const uint64_t> intEFCode(NULL, 0);
+	if (inWindow) intEFCode = GetEFWords(intDecompData, intScratch);
+
+	std::vector<uint64_t> intArrInt;
+	if (intEFCode.size > 0)
 	{
-		for (int k = 0; k < 8; ++k)
+		EliasFanoIndex<uint64_t> intIndex(intEFCode);
+		intIndex.Range(rangeBegin, rangeEnd, intArrInt);
+
+		if (rangeBegin > 0) intPrev = intIndex.Access(rangeBegin - 1);
+	}
+	else
+	{
+		DecodeIntegers<uint64_t>(intDecompData, intArrInt);
+
+		if (inWindow)
 		{
-			char2uint64.Char[k] = intDecompData[j * 8 + k];
+			if (rangeBegin > 0) intPrev = intArrInt[rangeBegin - 1];
+			intArrInt = std::vector<uint64_t>(intArrInt.begin() + rangeBegin, intArrInt.begin() + rangeEnd);
 		}
-		intEFCode.push_back(char2uint64.UInt64);
 	}
 
-	std::vector<uint64_t> intArrInt;
-	EliasFanoDecode64(intEFCode, intArrInt);
-
 	std::vector<float> intArrFloat(intArrInt.size());
-	intArrFloat[0] = powf((float)intArrInt[0], 2.0f);
 
-	for (int j = 1; j < intArrInt.size(); ++j)
+	for (int j = 0; j < intArrInt.size(); ++j)
 	{
-		intArrFloat[j] = powf((float)intArrInt[j] - (float)intArrInt[j - 1], 2.0f);
+		intArrFloat[j] = powf((float)intArrInt[j] - (float)intPrev, 2.0f);
+		intPrev = intArrInt[j];
 	}
 
 	if (mzArrFloat.size() != intArrFloat.size())
 	{
 		std::cout << "[Error] The size of mzArr was not equal to intensityArr!" << std::endl;
-		exit(0);
+		exit(1);
 	}
 
 	entry.numTypeKey.push_back("int_arr");
@@ -188,25 +207,36 @@ OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
 		std::vector<char> mobiDecompData;
 		ZSTDDecode(mobiCompData, mobiDecompData);
 
-		std::vector<uint32_t> mobiEFCode;
-		for (int j = 0; j < mobiDecompData.size() / 4; ++j)
+		uint32_t mobiPrev = 0;
+		std::vector<uint32_t> mobiScratch;
+		Span<const uint32_t> mobiEFCode(NULL, 0);
+		if (inWindow) mobiEFCode = GetEFWords(mobiDecompData, mobiScratch);
+
+		std::vector<uint32_t> mobiArrInt;
+		if (mobiEFCode.size > 0)
 		{
-			for (int k = 0; k < 4; ++k)
+			EliasFanoIndex<uint32_t> mobiEFIndex(mobiEFCode);
+			mobiEFIndex.Range(rangeBegin, rangeEnd, mobiArrInt);
+
+			if (rangeBegin > 0) mobiPrev = (uint32_t)mobiEFIndex.Access(rangeBegin - 1);
+		}
+		else
+		{
+			DecodeIntegers<uint32_t>(mobiDecompData, mobiArrInt);
+
+			if (inWindow)
 			{
-				char2uint32.Char[k] = mobiDecompData[j * 4 + k];
+				if (rangeBegin > 0) mobiPrev = mobiArrInt[rangeBegin - 1];
+				mobiArrInt = std::vector<uint32_t>(mobiArrInt.begin() + rangeBegin, mobiArrInt.begin() + rangeEnd);
 			}
-			mobiEFCode.push_back(char2uint32.UInt32);
 		}
 
-		std::vector<uint32_t> mobiArrInt;
-		EliasFanoDecode32(mobiEFCode, mobiArrInt);
-
 		std::vector<uint32_t> mobiIndex(mobiArrInt.size());
-		mobiIndex[0] = mobiArrInt[0];
 
-		for (int j = 1; j < mobiArrInt.size(); ++j)
+		for (int j = 0; j < mobiArrInt.size(); ++j)
 		{
-			mobiIndex[j] = mobiArrInt[j] - mobiArrInt[j - 1];
+			mobiIndex[j] = mobiArrInt[j] - mobiPrev;
+			mobiPrev = mobiArrInt[j];
 		}
 
 		int mIdx = -1;
@@ -217,7 +247,7 @@ OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
 		if (mIdx == -1)
 		{
 			std::cout << "[ERROR] wrong at mobilityValue of basic info!\n";
-			exit(0);
+			exit(1);
 		}
 
 		std::vector<float> mobiArrFloat(mobiIndex.size());
@@ -229,7 +259,7 @@ OMGParser::EntryData OMGParser::ProteomicsEntry(int entryId)
 		if (mzArrFloat.size() != mobiArrFloat.size())
 		{
 			std::cout << "[Error] The size of mzArr was not equal to mobilityArr!" << std::endl;
-			exit(0);
+			exit(1);
 		}
 
 		entry.numTypeKey.push_back("mobi_arr");
@@ -2,6 +2,7 @@
 #define UTILITY_H
 
 #include "namespace.h"
+#include "codec.h"
 
 void OMGParser::PaserTextData(std::string& text, std::string& title, 
 	std::vector<std::string>& keyList, std::vector<std::string>& valueList)
@@ -57,170 +58,240 @@ void OMGParser::PaserTextData(std::string& text, std::string& title,
 }
 
 void OMGParser::ZSTDDecode(std::vector<char>& input, std::vector<char>& output)
+{
+	// arrays inside superblocks are stored raw, the superblock is the frame
+	if (superblocked)
+	{
+		output = input;
+		return;
+	}
+
+	ZSTDDecodeFrame(input, output);
+}
+
+void OMGParser::ZSTDDecodeFrame(std::vector<char>& input, std::vector<char>& output)
 {
 	unsigned long long BufSize = ZSTD_getDecompressedSize(input.data(), input.size());
 
+	// one decompression context per calling thread, freed when the thread exits
+	static thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+
+	// frames compressed with a trained dictionary carry its ID
+	unsigned dictID = ZSTD_getDictID_fromFrame(input.data(), input.size());
+	ZSTD_DDict* ddict = NULL;
+
+	if (dictID != 0)
+	{
+		auto it = zstdDicts.find(dictID);
+		if (it == zstdDicts.end())
+		{
+			std::cout << "[ERROR] Missing zstd dictionary " << dictID << " in BasicInfo!" << std::endl;
+			exit(1);
+		}
+		ddict = it->second;
+	}
+
 	output.resize(BufSize);
-	size_t dstSize = ZSTD_decompress(output.data(), BufSize, input.data(), input.size());
+
+	size_t dstSize = 0;
+	if (ddict)
+	{
+		dstSize = ZSTD_decompress_usingDDict(dctx.get(), output.data(), BufSize, input.data(), input.size(), ddict);
+	}
+	else
+	{
+		dstSize = ZSTD_decompressDCtx(dctx.get(), output.data(), BufSize, input.data(), input.size());
+	}
 
 	if (ZSTD_isError(dstSize))
 	{
 		std::cout << "Error in ZSTD decompress!" << std::endl;
-		exit(0);
+		exit(1);
 	}
 }
 
-void OMGParser::Base64Decode(std::string& input, std::vector<char>& output)
+// Legacy streams hold bare EF words, tagged ones go through the codec registry.
+template <typename WordT, typename ValueT>
+void OMGParser::DecodeIntegers(std::vector<char>& input, std::vector<ValueT>& output)
 {
-	size_t srcSize = Base64::textToBinarySize(input.length());
+	if (codecTagged)
+	{
+		IntegerCodecs<WordT, ValueT>::Decode(input.data(), input.size(), output);
+		return;
+	}
 
-	output.resize(srcSize);
-	size_t binaryCount = Base64::textToBinary(input.c_str(), input.length(), &output[0]);
-	output.resize(binaryCount);
+	EliasFano<WordT, ValueT>::DecodeBytes(input.data(), input.size(), output);
 }
 
-void OMGParser::EliasFanoDecode32(std::vector<uint32_t>& EFCode, std::vector<uint32_t>& x)
+// EF words of a stream for random access, read in place when possible;
+// empty when it was stored with another codec.
+template <typename WordT>
+Span<const WordT> OMGParser::GetEFWords(std::vector<char>& input, std::vector<WordT>& scratch)
 {
-	//std::cout << "===========Decoding==============" << std::endl;
+	size_t skip = 0;
 
-	uint32_t n = EFCode[EFCode.size() - 2];
-	uint32_t totalBits = 32 * (EFCode.size() - 2);
+	if (codecTagged)
+	{
+		if (input.size() == 0 || (input[0] != CODEC_EF && input[0] != CODEC_PEF)) return Span<const WordT>(NULL, 0);
+		skip = 1;
+	}
 
-	uint32_t Length = EFCode.back() % 100;
-	uint32_t upperBits = (uint32_t)(EFCode.back() / 100);
-	uint32_t lowerBits = totalBits - upperBits;
+	return EFWordView(input.data() + skip, input.size() - skip, scratch);
+}
 
-	uint32_t beginBit = totalBits;
+void OMGParser::ReadFileBytes(uint64_t startPos, uint64_t byteCount, char* buffer)
+{
+	if (readMode == "disk")
+	{
+#ifdef _WIN32
+		filePtrPos = startPos;
+#endif // !_WIN32
 
-	uint32_t bitMod = 0;
+#ifdef __linux__
+		filePtrPos.__pos = startPos;
+#endif // __linux__
 
-	uint32_t lowerIdx = 0;
-	uint32_t upperIdx = 0;
+		fsetpos(omgFilePtr, &filePtrPos);
 
-	uint32_t count0 = 0;
-	uint32_t count1 = 0;
+		size_t readSize = fread(buffer, sizeof(char), byteCount, omgFilePtr);
+	}
+	else
+	{
+		memcpy(buffer, fullFileBuffer + startPos, byteCount);
+	}
+}
 
-	uint32_t count = 0;
-	uint32_t inferior = 0;
+// Maps the whole file read-only, the OS pages entries in as they are read.
+char* OMGParser::MapFile()
+{
+	char* view = NULL;
 
-	x.resize(n, 0);
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(omgFileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 
-	for (uint32_t i = 0; i < n; ++i)
+	if (fileHandle != INVALID_HANDLE_VALUE)
 	{
-		for (uint32_t j = beginBit; j > lowerBits; --j)
+		HANDLE mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapHandle)
 		{
-			if ((bitMod = (j & 31)) == 0) bitMod = 32; // (j % 32) == (j & 31)
-
-			if ((EFCode[upperIdx >> 5] >> (bitMod - 1)) & 1)
-			{
-				++count1;
-			}
-			else
-			{
-				++count0;
-			}
-
-			++upperIdx;
-
-			if (count1 >= (i + 1))
-			{
-				beginBit = j - 1;
-				break;
-			}
+			view = (char*)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapHandle);
 		}
+		CloseHandle(fileHandle);
+	}
+#else
+	view = (char*)mmap(NULL, omgFileVolume, PROT_READ, MAP_SHARED, fileno(omgFilePtr), 0);
+	if (view == (char*)MAP_FAILED) view = NULL;
+#endif
 
-		lowerIdx = upperBits + i * Length;
-
-		count = Length - 1;
-		inferior = 0;
-
-		for (int k = lowerBits - i * Length;
-			k > lowerBits - (i + 1) * Length; --k)
-		{
-			if ((bitMod = (k & 31)) == 0) bitMod = 32;
+	if (!view)
+	{
+		std::cout << "[ERROR] Cannot map " << omgFileName << " into memory!\n";
+		exit(1);
+	}
 
-			if ((EFCode[lowerIdx >> 5] >> (bitMod - 1)) & 1)
-			{
-				inferior += 1 << count;
-			}
-			--count;
-			++lowerIdx;
-		}
+	return view;
+}
 
-		x[i] = (count0 << Length) + inferior;
-	}
+void OMGParser::UnmapFile()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(fullFileBuffer);
+#else
+	munmap(fullFileBuffer, omgFileVolume);
+#endif
+	fullFileBuffer = NULL;
 }
 
-void OMGParser::EliasFanoDecode64(std::vector<uint64_t>& EFCode, std::vector<uint64_t>& x)
+std::string OMGParser::ReadEntry(int entryId)
 {
-	//std::cout << "===========Decoding==============" << std::endl;
+	if (!superblocked)
+	{
+		std::string entryString(blockIndex[2 * entryId + 1], '\0');
+		ReadFileBytes(blockIndex[2 * entryId], blockIndex[2 * entryId + 1], &entryString[0]);
 
-	uint64_t n = EFCode[EFCode.size() - 2];
-	uint64_t totalBits = 64ULL * (EFCode.size() - 2);
+		if (verifyReads) CheckBlock(entryId, entryString.data());
 
-	uint64_t Length = EFCode.back() % 100ULL;
-	uint64_t upperBits = (uint64_t)(EFCode.back() / 100ULL);
-	uint64_t lowerBits = totalBits - upperBits;
+		return entryString;
+	}
 
-	uint64_t beginBit = totalBits;
+	// the superblock each thread decompressed last, so the following entries
+	// of the same superblock are served without touching the file again
+	struct SuperblockCache
+	{
+		uint64_t parserSerial = 0;
+		uint64_t block = 0;
+		std::vector<char> data;
+		std::vector<uint64_t> entryPos;
+	};
+	static thread_local SuperblockCache cache;
 
-	uint64_t bitMod = 0;
+	uint64_t block = std::upper_bound(blockFirstEntry, blockFirstEntry + blockCount, (uint64_t)entryId) - blockFirstEntry - 1;
+	uint64_t index = entryId - blockFirstEntry[block];
 
-	uint64_t lowerIdx = 0;
-	uint64_t upperIdx = 0;
+	if (cache.parserSerial != parserSerial || cache.block != block)
+	{
+		std::vector<char> compData(blockIndex[2 * block + 1]);
+		ReadFileBytes(blockIndex[2 * block], blockIndex[2 * block + 1], compData.data());
 
-	uint64_t count0 = 0;
-	uint64_t count1 = 0;
+		if (verifyReads) CheckBlock(block, compData.data());
 
-	uint64_t count = 0;
-	uint64_t inferior = 0;
+		cache.parserSerial = 0;
+		ZSTDDecodeFrame(compData, cache.data);
 
-	x.resize(n, 0);
+		Char2UInt32 char2uint32;
+		memcpy(char2uint32.Char, cache.data.data(), 4);
+		uint32_t count = char2uint32.UInt32;
 
-	for (uint64_t i = 0; i < n; ++i)
-	{
-		for (uint64_t j = beginBit; j > lowerBits; --j)
+		cache.entryPos.resize(count + 1);
+		cache.entryPos[0] = (count + 1) * 4;
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			if ((bitMod = (j & 63ULL)) == 0) bitMod = 64ULL; // (j % 64) == (j & 63)
-
-			if ((EFCode[upperIdx >> 6ULL] >> (bitMod - 1ULL)) & 1ULL)
-			{
-				++count1;
-			}
-			else
-			{
-				++count0;
-			}
-
-			++upperIdx;
+			memcpy(char2uint32.Char, cache.data.data() + (i + 1) * 4, 4);
+			cache.entryPos[i + 1] = cache.entryPos[i] + char2uint32.UInt32;
+		}
 
-			if (count1 >= (i + 1))
-			{
-				beginBit = j - 1;
-				break;
-			}
+		if (cache.entryPos[count] > cache.data.size())
+		{
+			std::cout << "[ERROR] Superblock " << block << " is truncated!" << std::endl;
+			exit(1);
 		}
 
-		lowerIdx = upperBits + i * Length;
+		cache.parserSerial = parserSerial;
+		cache.block = block;
+	}
 
-		count = Length - 1;
-		inferior = 0;
+	return std::string(cache.data.data() + cache.entryPos[index], cache.data.data() + cache.entryPos[index + 1]);
+}
 
-		for (int k = lowerBits - i * Length;
-			k > lowerBits - (i + 1) * Length; --k)
-		{
-			if ((bitMod = (k & 63ULL)) == 0) bitMod = 64ULL;
+// BasicInfo, the footer tables and the footer against OMGFooter.checksum.
+bool OMGParser::CheckIndex()
+{
+	uint64_t indexSize = omgFileVolume - sizeof(OMGFooter) - omgFooter.headerOffset;
 
-			if ((EFCode[lowerIdx >> 6ULL] >> (bitMod - 1ULL)) & 1ULL)
-			{
-				inferior += 1ULL << count;
-			}
-			--count;
-			++lowerIdx;
-		}
+	std::vector<char> index(indexSize);
+	ReadFileBytes(omgFooter.headerOffset, indexSize, index.data());
+
+	return OMGFooterChecksum(index.data(), indexSize, omgFooter) == omgFooter.checksum;
+}
 
-		x[i] = (count0 << Length) + inferior;
+void OMGParser::CheckBlock(uint64_t block, const char* data)
+{
+	if (blockChecksum && CRC32C::Compute(data, blockIndex[2 * block + 1]) != blockChecksum[block])
+	{
+		std::cout << "[ERROR] Block " << block << " of " << omgFileName << " fails its checksum, the file is corrupted!\n";
+		exit(1);
 	}
 }
 
+void OMGParser::Base64Decode(std::string& input, std::vector<char>& output)
+{
+	size_t srcSize = Base64::textToBinarySize(input.length());
+
+	output.resize(srcSize);
+	size_t binaryCount = Base64::textToBinary(input.c_str(), input.length(), &output[0]);
+	output.resize(binaryCount);
+}
+
 #endif // !UTILITY_H
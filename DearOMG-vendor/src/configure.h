@@ -55,6 +55,105 @@ void DearOMG::ReadConfigure(int argc, char* argv[])
 				}
 			}
 
+			if (line.find("--pef") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				// vendor files only hold m/z and intensity arrays
+				std::stringstream arrays(sub);
+				std::string array;
+				while (std::getline(arrays, array, ';'))
+				{
+					if (array != "mz" && array != "intensity")
+					{
+						std::cout << "[ERROR] unknown --pef array " + array + ", use mz or intensity." << std::endl;
+						exit(0);
+					}
+				}
+
+				pefMz = sub.find("mz") != sub.npos;
+				pefIntensity = sub.find("intensity") != sub.npos;
+			}
+
+			if (line.find("--codec") != line.npos)
+			{
+				int pos = line.find("=");
+				codecPolicy = line.substr(pos + 1);
+
+				if (codecPolicy != "ef" && codecPolicy != "smallest" && codecPolicy != "fastest")
+				{
+					std::cout << "[ERROR] unknown codec policy " + codecPolicy + ", use ef, smallest or fastest." << std::endl;
+					exit(0);
+				}
+			}
+
+			if (line.find("--dict_samples") != line.npos)
+			{
+				int pos = line.find("=");
+				dictSamples = std::stoi(line.substr(pos + 1));
+			}
+
+			if (line.find("--superblock") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				size_t unit = 0;
+				if (sub.find("KB") != sub.npos) unit = KB;
+				else if (sub.find("MB") != sub.npos) unit = MB;
+				else if (sub.find("B") != sub.npos) unit = 1;
+
+				if (unit == 0)
+				{
+					superblockEntries = std::stoul(sub);
+				}
+				else
+				{
+					superblockBytes = std::stoull(sub) * unit;
+				}
+			}
+
+			if (line.find("--level") != line.npos)
+			{
+				int pos = line.find("=");
+				std::string sub = line.substr(pos + 1);
+
+				int colon = sub.find(":");
+				if (colon == sub.npos)
+				{
+					minZstdLevel = maxZstdLevel = std::stoi(sub);
+				}
+				else
+				{
+					minZstdLevel = std::stoi(sub.substr(0, colon));
+					maxZstdLevel = std::stoi(sub.substr(colon + 1));
+				}
+
+				if (minZstdLevel < 1 || maxZstdLevel > ZSTD_maxCLevel() || minZstdLevel > maxZstdLevel)
+				{
+					std::cout << "[ERROR] zstd level should be within 1:" << ZSTD_maxCLevel() << "!" << std::endl;
+					exit(0);
+				}
+			}
+
+			if (line.find("--long") != line.npos)
+			{
+				int pos = line.find("=");
+				longMatching = line.substr(pos + 1) == "1";
+			}
+
+			if (line.find("--append") != line.npos)
+			{
+				int pos = line.find("=");
+				appendFile = line.substr(pos + 1);
+
+				for (int j = 0; j < appendFile.length(); ++j)
+				{
+					if (appendFile[j] == '\\') appendFile[j] = '/';
+				}
+			}
+
 			if (line.find("--out_dir") != line.npos)
 			{
 				int pos = line.find("=");
@@ -89,7 +188,7 @@ void DearOMG::ReadConfigure(int argc, char* argv[])
 			}
 		}
 
-		if (outputDir.length() == 0)
+		if (outputDir.length() == 0 && appendFile.length() == 0)
 		{
 			printf("\nThere is no parameter of output directory: --out_dir\n");
 			printf(HELP_INFO.c_str());
@@ -113,6 +212,21 @@ void DearOMG::ReadConfigure(int argc, char* argv[])
 			printf(HELP_INFO.c_str());
 			exit(0);
 		}
+		if (PackSuperblocks() && writeMode != "binary")
+		{
+			std::cout << "[ERROR] --superblock only supports binary write mode!" << std::endl;
+			exit(0);
+		}
+		if (appendFile.length() > 0 && writeMode != "binary")
+		{
+			std::cout << "[ERROR] --append only supports binary write mode!" << std::endl;
+			exit(0);
+		}
+		if (PackSuperblocks() && dictSamples > 0)
+		{
+			std::cout << "[WARNING] --dict_samples is ignored with --superblock!" << std::endl;
+			dictSamples = 0;
+		}
 	}
 
 #endif // !DEBUG
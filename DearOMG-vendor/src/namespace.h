@@ -15,17 +15,31 @@
 #include <bitset>
 #include <vector>
 #include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <iostream>
 
+#ifdef __linux__
+#include <unistd.h>
+#endif // __linux__
+
 #include "zstd.h"
+#include "zdict.h"
 #include "Base64.h"
+#include "omgfooter.h"
+#include "omgwriter.h"
 #include "tbb/tbb.h"
 
-class DearOMG
+#define	KB 1024
+#define	MB 1048576
+
+class DearOMG : public OMGWriter
 {
 public:
 	DearOMG(int argc, char* argv[])
@@ -39,13 +53,18 @@ public:
 	//=========================================================================
 	// Custom parameters
 	//=========================================================================
-	std::string writeMode;
-	std::string outputDir;
 	std::vector<std::string> inputFileList;
 
 	double mzPrecision = -1.0;
 	bool skipZeroIntensity = true;
 
+	// arrays written as partitioned Elias-Fano
+	bool pefMz = false;
+	bool pefIntensity = false;
+
+	// ef keeps the legacy untagged streams, smallest/fastest pick a codec per array
+	std::string codecPolicy = "ef";
+
 private:
 	//=========================================================================
 	// Information of software
@@ -65,6 +84,13 @@ private:
 		"\n--write_mode:\tdata storage type. " + SOFTWARE_NAME + " support binary, json, yaml. defalut=binary.\n"
 		"\n--precision:\tprecision of m/z array. defalut=0.001.\n"
 		"\n--skip_zero:\tskip ions with zero intensity or not. true for 1 and false for 0. defalut=1.\n"
+		"\n--pef:\tarrays encoded with partitioned Elias-Fano, e.g. mz;intensity. options: mz, intensity. defalut=none.\n"
+		"\n--codec:\tinteger codec policy. options: ef, smallest, fastest. defalut=ef.\n"
+		"\n--dict_samples:\tentries sampled to train one zstd dictionary per array type, 0 for none. defalut=0.\n"
+		"\n--superblock:\tentries packed into one zstd frame, a count (e.g. 64) or a size (e.g. 512KB, 4MB). binary mode only. defalut=none.\n"
+		"\n--level:\tzstd level, or a min:max range adapted to the spare capacity of the machine, e.g. 1:9. defalut=1.\n"
+		"\n--long:\tlong distance matching at the top of the level range. true for 1 and false for 0. defalut=0.\n"
+		"\n--append:\tbinary OMG file to add the converted entries to, instead of writing new files to --out_dir. defalut=none.\n"
 		"\n--out_dir:\toutput directory or path.\n" +
 		"\n--input:\tinput file list. " + SOFTWARE_NAME + " supports *.wiff, *.raw, *.d, *.imzML, *.fastq formats.\n" +
 		"\nNote: the paths of input files and output directory should not include 'Space'.\n\n";
@@ -100,6 +126,8 @@ private:
 		int msLevel = -1;
 		float precursorMz;
 
+		int zstdLevel = 1;
+
 		std::string info;
 		std::string mzEncode;
 		std::string intensityEncode;
@@ -133,12 +161,6 @@ private:
 	//=====================================================================//
 	void ReadConfigure(int argc, char* argv[]);
 
-	void EliasFanoEncode32(std::vector<uint32_t>& x, std::vector<uint32_t>& EFCode);
-	void EliasFanoDecode32(std::vector<uint32_t>& EFCode, std::vector<uint32_t>& x);
-
-	void EliasFanoEncode64(std::vector<uint64_t>& x, std::vector<uint64_t>& EFCode);
-	void EliasFanoDecode64(std::vector<uint64_t>& EFCode, std::vector<uint64_t>& x);
-
 	void LoadWiffFile(std::string inputFile);
 	void LoadThermoRawFile(std::string inputFile);
 
@@ -148,12 +170,10 @@ private:
 	// Utilities
 	//=====================================================================//
 	std::string GetTime();
-	void ZSTDEncode(std::vector<char>& input, std::vector<char>& output);
 	void Base64Encode(std::vector<char>& input, std::vector<char>& output);
 
-	void ReWriteOMGFile(std::string& inputFile,
-		std::string& fileName, std::string& baseInfo,
-		std::vector< std::vector<uint64_t> >& offsetVectorTmp);
+	template <typename WordT, typename ValueT>
+	void EncodeIntegers(std::vector<ValueT>& x, bool partitioned, std::vector<char>& output);
 
 	std::vector<std::string> GetInputFileNameAndSuffix(std::string inputFileName);
 
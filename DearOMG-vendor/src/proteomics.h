@@ -9,185 +9,183 @@ void DearOMG::EncodeProteomics(int nThreads, std::string inputFile)
 {
 	std::vector<std::string> nameSuffix = GetInputFileNameAndSuffix(inputFile);
 
-	std::string tmpFileName = outputDir + nameSuffix[0] + ".omg.tmp";
-
-	FILE* tmpFile = fopen(tmpFileName.c_str(), "wb");
+	uint64_t entryCount = 0;
+	std::vector< std::vector<uint64_t> > offsetVectorTmp;
 
-	if (!tmpFile)
+	// the leading parameters of every binary entry, kept as footer columns
+	metaColumns =
 	{
-		std::cout << "[ERROR] Cannot create " << tmpFileName << "\n"
-			<< "[ERROR] Please check your file or directory!" << std::endl;
-		exit(0);
-	}
+		MakeOMGColumn("RT", OMG_COLUMN_FLOAT32),
+		MakeOMGColumn("precursorMz", OMG_COLUMN_FLOAT32),
+		MakeOMGColumn("collisionEnergy", OMG_COLUMN_FLOAT32),
+		MakeOMGColumn("scanIndex", OMG_COLUMN_UINT32),
+		MakeOMGColumn("msLevel", OMG_COLUMN_UINT32),
+		MakeOMGColumn("chargeState", OMG_COLUMN_UINT32)
+	};
+
+	// BasicInfo lines known before the input is read, checked against an --append file up front
+	std::string codecTag = codecPolicy == "ef" ? "0" : "1";
+	std::string knownInfo = " omics: Proteomics\n writeFormat: " + writeMode + "\n codecTag: " + codecTag + "\n";
 
 	uint64_t startPos = 0;
-	uint64_t entryCount = 0;
-	std::vector< std::vector<uint64_t> > offsetVectorTmp;
+	FILE* payloadFile = OpenPayloadFile(nameSuffix[0], startPos, knownInfo);
 	
-	tbb::parallel_pipeline(nThreads,
-		tbb::make_filter<void, ProtData>(tbb::filter::serial_out_of_order,
-			[&](tbb::flow_control& fc)
-			{
-				ProtData protData;
-				ProteomeQueue.pop(protData);
+	// Encodes one entry. TrainDictionaries also runs it over the sampled entries.
+	auto encodeEntry = [&](ProtData protData)
+	{
+		if (protData.msLevel == -1 || protData.spectrum[0].size() < 10)
+		{
+			return protData;
+		}
 
-				if (protData.stop)
-				{
-					fc.stop();
-				}
+		uint64_t sumIntensity = 0;
+		std::vector<uint32_t> mzArr;
+		std::vector<uint64_t> intensityArr;
 
-				return protData;
-			})&
-		tbb::make_filter<ProtData, ProtData>(tbb::filter::parallel,
-			[&](ProtData protData)
-			{
-				if (protData.msLevel == -1 || protData.spectrum[0].size() < 10)
-				{
-					return protData;
-				}
+		for (int i = 0; i < protData.spectrum[0].size(); ++i)
+		{
+			if (skipZeroIntensity && protData.spectrum[1][i] < 0.01) continue;
+			
+			mzArr.push_back((uint32_t)(std::round(protData.spectrum[0][i] * mzPrecision)));
 
-				uint64_t sumIntensity = 0;
-				std::vector<uint32_t> mzArr;
-				std::vector<uint64_t> intensityArr;
+			sumIntensity += (uint64_t)(std::round(std::sqrt(protData.spectrum[1][i])));
 
-				for (int i = 0; i < protData.spectrum[0].size(); ++i)
-				{
-					if (skipZeroIntensity && protData.spectrum[1][i] < 0.01) continue;
-					
-					mzArr.push_back((uint32_t)(std::round(protData.spectrum[0][i] * mzPrecision)));
+			intensityArr.push_back(sumIntensity);
+		}
+		
+		if (mzArr.size() == 0)
+		{
+			return protData;
+		}
 
-					sumIntensity += (uint64_t)(std::round(std::sqrt(protData.spectrum[1][i])));
+		std::vector<char> mzCharCode;
+		EncodeIntegers<uint32_t>(mzArr, pefMz, mzCharCode);
 
-					intensityArr.push_back(sumIntensity);
-				}
-				
-				if (mzArr.size() == 0)
-				{
-					return protData;
-				}
+		std::vector<char> intenCharCode;
+		EncodeIntegers<uint64_t>(intensityArr, pefIntensity, intenCharCode);
 
-				std::vector<uint32_t> mzEFcode;
-				EliasFanoEncode32(mzArr, mzEFcode);
+		std::vector<char> mzCompData;
+		std::vector<char> intenCompData;
 
-				Char2UInt32 char2uint32;
-				std::vector<char> mzCharCode(mzEFcode.size() * 4);
-				for (int i = 0; i < mzEFcode.size(); ++i)
-				{
-					char2uint32.UInt32 = mzEFcode[i];
-					for (int j = 0; j < 4; ++j)
-					{
-						mzCharCode[4 * i + j] = char2uint32.Char[j];
-					}
-				}
+		ZSTDEncode(mzCharCode, mzCompData, "mz_arr", protData.zstdLevel);
+		ZSTDEncode(intenCharCode, intenCompData, "int_arr", protData.zstdLevel);
+
+		if (writeMode == "json" || writeMode == "yaml")
+		{
+			std::vector<char> mzCode;
+			std::vector<char> intensityCode;
 
-				std::vector<uint64_t> intensityEFcode;
-				EliasFanoEncode64(intensityArr, intensityEFcode);
+			Base64Encode(mzCompData, mzCode);
+			Base64Encode(intenCompData, intensityCode);
+
+			if (writeMode == "json")
+			{
+				protData.info = " \"scan_" + std::to_string(protData.scanIndex) + "\": {\n"
+					+ "  \"RT\": " + std::to_string(protData.rt) + ",\n"
+					+ "  \"msLevel\": " + std::to_string(protData.msLevel) + ",\n"
+					+ "  \"precursorMz\": " + std::to_string(protData.precursorMz) + ",\n"
+					+ "  \"chargeState\": " + std::to_string(protData.charge) + ",\n";
+
+				protData.mzEncode = "  \"mz_arr\": \"";
+				protData.mzEncode.append(mzCode.begin(), mzCode.end());
+				protData.mzEncode.append("\",\n");
+
+				protData.intensityEncode = "  \"int_arr\": \"";
+				protData.intensityEncode.append(intensityCode.begin(), intensityCode.end());
+				protData.intensityEncode.append("\"\n },\n");
+			}
+
+			if (writeMode == "yaml")
+			{
+				protData.info = "scan_" + std::to_string(protData.scanIndex) + ":\n"
+					+ " RT: " + std::to_string(protData.rt) + "\n"
+					+ " msLevel: " + std::to_string(protData.msLevel) + "\n"
+					+ " precursorMz: " + std::to_string(protData.precursorMz) + "\n"
+					+ " chargeState: " + std::to_string(protData.charge) + "\n";
+
+				protData.mzEncode = " mz_arr: ";
+				protData.mzEncode.append(mzCode.begin(), mzCode.end());
+				protData.mzEncode.append("\n");
+
+				protData.intensityEncode = " int_arr: ";
+				protData.intensityEncode.append(intensityCode.begin(), intensityCode.end());
+				protData.intensityEncode.append("\n\n");
+			}
+		}
+		if (writeMode == "binary")
+		{
+			protData.mzEncode.assign(mzCompData.begin(), mzCompData.end());
+			protData.intensityEncode.assign(intenCompData.begin(), intenCompData.end());
 
-				Char2UInt64 char2uint64;
-				std::vector<char> intenCharCode(intensityEFcode.size() * 8);
+			protData.info = "";
+			Char2Float char2float;
+			Char2UInt32 char2uint32;
 
-				for (int i = 0; i < intensityEFcode.size(); ++i)
+			std::vector<float> paramsFloat = { protData.rt , protData.precursorMz, -1.0f };
+			
+			for (int i = 0; i < paramsFloat.size(); ++i)
+			{
+				char2float.Float = paramsFloat[i];
+				for (int j = 0; j < 4; ++j)
 				{
-					char2uint64.UInt64 = intensityEFcode[i];
-					for (int j = 0; j < 8; ++j)
-					{
-						intenCharCode[8 * i + j] = char2uint64.Char[j];
-					}
+					protData.info += char2float.Char[j];
 				}
+			}
 
-				std::vector<char> mzCompData;
-				std::vector<char> intenCompData;
+			std::vector<uint32_t> paramsUInt =
+			{
+				protData.scanIndex,
+				(uint32_t)protData.msLevel,
+				(uint32_t)protData.charge,
+				(uint32_t)protData.mzEncode.length(),
+				(uint32_t)protData.intensityEncode.length(),
+				(uint32_t)0
+			};
+
+			for (int i = 0; i < paramsUInt.size(); ++i)
+			{
+				char2uint32.UInt32 = paramsUInt[i];
+				for (int j = 0; j < 4; ++j)
+				{
+					protData.info += char2uint32.Char[j];
+				}
+			}
+		}
+
+		return protData;
+	};
 
-				ZSTDEncode(mzCharCode, mzCompData);
-				ZSTDEncode(intenCharCode, intenCompData);
+	std::deque<ProtData> sampledData;
+	TrainDictionaries(ProteomeQueue, sampledData, encodeEntry);
+	ResetZSTDLevel();
 
-				if (writeMode == "json" || writeMode == "yaml")
+	tbb::parallel_pipeline(nThreads,
+		tbb::make_filter<void, ProtData>(tbb::filter::serial_out_of_order,
+			[&](tbb::flow_control& fc)
+			{
+				ProtData protData;
+				if (sampledData.empty())
 				{
-					std::vector<char> mzCode;
-					std::vector<char> intensityCode;
-
-					Base64Encode(mzCompData, mzCode);
-					Base64Encode(intenCompData, intensityCode);
-
-					if (writeMode == "json")
-					{
-						protData.info = " \"scan_" + std::to_string(protData.scanIndex) + "\": {\n"
-							+ "  \"RT\": " + std::to_string(protData.rt) + ",\n"
-							+ "  \"msLevel\": " + std::to_string(protData.msLevel) + ",\n"
-							+ "  \"precursorMz\": " + std::to_string(protData.precursorMz) + ",\n"
-							+ "  \"chargeState\": " + std::to_string(protData.charge) + ",\n";
-
-						protData.mzEncode = "  \"mz_arr\": \"";
-						protData.mzEncode.append(mzCode.begin(), mzCode.end());
-						protData.mzEncode.append("\",\n");
-
-						protData.intensityEncode = "  \"int_arr\": \"";
-						protData.intensityEncode.append(intensityCode.begin(), intensityCode.end());
-						protData.intensityEncode.append("\"\n },\n");
-					}
-
-					if (writeMode == "yaml")
-					{
-						protData.info = "scan_" + std::to_string(protData.scanIndex) + ":\n"
-							+ " RT: " + std::to_string(protData.rt) + "\n"
-							+ " msLevel: " + std::to_string(protData.msLevel) + "\n"
-							+ " precursorMz: " + std::to_string(protData.precursorMz) + "\n"
-							+ " chargeState: " + std::to_string(protData.charge) + "\n";
-
-						protData.mzEncode = " mz_arr: ";
-						protData.mzEncode.append(mzCode.begin(), mzCode.end());
-						protData.mzEncode.append("\n");
-
-						protData.intensityEncode = " int_arr: ";
-						protData.intensityEncode.append(intensityCode.begin(), intensityCode.end());
-						protData.intensityEncode.append("\n\n");
-					}
+					ProteomeQueue.pop(protData);
 				}
-				if (writeMode == "binary")
+				else
 				{
-					protData.mzEncode.assign(mzCompData.begin(), mzCompData.end());
-					protData.intensityEncode.assign(intenCompData.begin(), intenCompData.end());
-
-					protData.info = "";
-					Char2Float char2float;
-					Char2UInt32 char2uint32;
-
-					std::vector<float> paramsFloat = { protData.rt , protData.precursorMz, -1.0f };
-					
-					for (int i = 0; i < paramsFloat.size(); ++i)
-					{
-						char2float.Float = paramsFloat[i];
-						for (int j = 0; j < 4; ++j)
-						{
-							protData.info += char2float.Char[j];
-						}
-					}
-
-					std::vector<uint32_t> paramsUInt =
-					{
-						protData.scanIndex,
-						(uint32_t)protData.msLevel,
-						(uint32_t)protData.charge,
-						(uint32_t)protData.mzEncode.length(),
-						(uint32_t)protData.intensityEncode.length(),
-						(uint32_t)0
-					};
-
-					for (int i = 0; i < paramsUInt.size(); ++i)
-					{
-						char2uint32.UInt32 = paramsUInt[i];
-						for (int j = 0; j < 4; ++j)
-						{
-							protData.info += char2uint32.Char[j];
-						}
-					}
+					protData = sampledData.front();
+					sampledData.pop_front();
 				}
 
-				return protData;
+				if (protData.stop)
+				{
+					fc.stop();
+				}
 
-			}) &
+				protData.zstdLevel = AdaptZSTDLevel(ProteomeQueue.size(), nThreads);
 
-		tbb::make_filter<ProtData, void>(tbb::filter::serial_out_of_order,
+				return protData;
+			})&
+		tbb::make_filter<ProtData, ProtData>(tbb::filter::parallel, encodeEntry) &
+
+		tbb::make_filter<ProtData, void>(PackSuperblocks() ? tbb::filter::serial_in_order : tbb::filter::serial_out_of_order,
 			[&](ProtData protData)
 			{
 				if (protData.mzEncode.length() == 0)
@@ -197,24 +195,18 @@ void DearOMG::EncodeProteomics(int nThreads, std::string inputFile)
 				
 				++entryCount;
 
-				fwrite(protData.info.c_str(), 1, protData.info.length(), tmpFile);
-				fwrite(protData.mzEncode.c_str(), 1, protData.mzEncode.length(), tmpFile);
-				fwrite(protData.intensityEncode.c_str(), 1, protData.intensityEncode.length(), tmpFile);
-
-				size_t writeBytes = protData.info.length() + 
-					protData.mzEncode.length() + 
-					protData.intensityEncode.length();
-
-				std::vector<uint64_t> tmp = { protData.scanIndex, startPos, writeBytes };
-				offsetVectorTmp.push_back(tmp);
+				protData.info += protData.mzEncode;
+				protData.info += protData.intensityEncode;
 
-				startPos += writeBytes;
+				WriteEntry(payloadFile, startPos, offsetVectorTmp, protData.scanIndex, protData.zstdLevel,
+					protData.info.c_str(), protData.info.length());
 
 				return NULL;
 			})
 		);
 
-	fclose(tmpFile);
+	FlushSuperblock(payloadFile, startPos);
+	fclose(payloadFile);
 
 	tbb::parallel_sort(offsetVectorTmp.begin(), offsetVectorTmp.end(),
 		[](std::vector<uint64_t>& x, std::vector<uint64_t>& y)
@@ -239,6 +231,8 @@ void DearOMG::EncodeProteomics(int nThreads, std::string inputFile)
 			"  \"date\": \"" + date + "\",\n"
 			"  \"parentFile\": \"" + inputFile + "\",\n"
 			"  \"parentFormat\": \"" + nameSuffix[1] + "\",\n"
+			"  \"codecTag\": \"" + codecTag + "\",\n" +
+			DictionaryInfo() +
 			"  \"scanCount\": \"" + std::to_string(entryCount) + "\",\n"
 			"  \"startTime\": \"" + protHeader.startTime + "\",\n"
 			"  \"endTime\": \"" + protHeader.endTime + "\",\n"
@@ -259,6 +253,8 @@ void DearOMG::EncodeProteomics(int nThreads, std::string inputFile)
 			" date: " + date + "\n"
 			" parentFile: " + inputFile + "\n"
 			" parentFormat: " + nameSuffix[1] + "\n"
+			" codecTag: " + codecTag + "\n" +
+			DictionaryInfo() +
 			" scanCount: " + std::to_string(entryCount) + "\n"
 			" startTime: " + protHeader.startTime + "\n"
 			" endTime: " + protHeader.endTime + "\n"
@@ -215,14 +215,18 @@ class DearOMGParser:
             raise DearOMGError(f"DearOMG-parser.exe not found at {self.parser_exe}")
     
     def parse_omg_file(self, omg_file: str, num_threads: int = 4, 
-                      read_mode: str = "memory") -> Dict[str, any]:
+                      read_mode: str = "memory",
+                      filters: Optional[Dict[str, Tuple[float, float]]] = None) -> Dict[str, any]:
         """
         Parse an OMG file and extract its contents.
         
         Args:
             omg_file: Path to the OMG file to parse.
             num_threads: Number of threads to use for parsing. Default: 4
-            read_mode: Read mode, either "disk" or "memory". Default: "memory"
+            read_mode: Read mode, one of "disk", "memory" or "mmap". Default: "memory"
+            filters: Footer columns mapped to (low, high) ranges, e.g.
+                    {"msLevel": (2, 2), "precursorMz": (500, 510)}. Only
+                    matching entries are read. Binary OMG files only. Default: None
             
         Returns:
             Dictionary containing parsed data and metadata.
@@ -233,8 +237,8 @@ class DearOMGParser:
         if not Path(omg_file).exists():
             raise DearOMGError(f"OMG file not found: {omg_file}")
         
-        if read_mode not in ["disk", "memory"]:
-            raise DearOMGError("Read mode must be either 'disk' or 'memory'")
+        if read_mode not in ["disk", "memory", "mmap"]:
+            raise DearOMGError("Read mode must be 'disk', 'memory' or 'mmap'")
         
         cmd = [
             str(self.parser_exe),
@@ -243,6 +247,10 @@ class DearOMGParser:
             f"--omg={omg_file}"
         ]
         
+        if filters:
+            cmd.append("--filter=" + ";".join(
+                f"{column}:{low}:{high}" for column, (low, high) in filters.items()))
+        
         try:
             result = subprocess.run(cmd, capture_output=True, text=True, check=True)
             
@@ -270,6 +278,33 @@ class DearOMGParser:
         except subprocess.CalledProcessError as e:
             raise DearOMGError(f"Parsing failed: {e.stderr}")
     
+    def verify_omg_file(self, omg_file: str, num_threads: int = 4,
+                        read_mode: str = "disk") -> bool:
+        """
+        Check every block of a binary OMG file against its checksum.
+        
+        Args:
+            omg_file: Path to the OMG file to verify.
+            num_threads: Number of threads to use. Default: 4
+            read_mode: Read mode, one of "disk", "memory" or "mmap". Default: "disk"
+            
+        Returns:
+            True if the index and all blocks pass, False otherwise.
+        """
+        if not Path(omg_file).exists():
+            raise DearOMGError(f"OMG file not found: {omg_file}")
+        
+        cmd = [
+            str(self.parser_exe),
+            f"--mt={num_threads}",
+            f"--read={read_mode}",
+            "--verify=1",
+            f"--omg={omg_file}"
+        ]
+        
+        result = subprocess.run(cmd, capture_output=True, text=True)
+        return result.returncode == 0
+    
     def get_file_info(self, omg_file: str) -> Dict[str, any]:
         """
         Get basic information about an OMG file without full parsing.
@@ -322,7 +357,7 @@ def parse_omg(omg_file: str,
     Args:
         omg_file: Path to the OMG file to parse.
         dear_omg_path: Path to Dear-OMG installation directory.
-        **kwargs: Additional arguments for parsing (num_threads, read_mode).
+        **kwargs: Additional arguments for parsing (num_threads, read_mode, filters).
         
     Returns:
         Dictionary with parsing results.